@@ -0,0 +1,56 @@
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include "config.h"
+
+// Benchmarks de rendimiento. Se ejecutan desde app_main cuando BENCH_ENABLE != 0, en
+// la placa (entorno esp32dev_bench de platformio.ini) y en el host con el port POSIX
+// de FreeRTOS (idf.py --preview set-target linux, idf.py -DBENCH_ENABLE=1 build).
+//
+// Cada resultado es una línea JSON en stdout, con un formato estable para comparar
+// ejecuciones (tools/bench_compare.py); el resto del log no empieza por '{':
+//   {"v":1,"target":"esp32","t_s":1.234,"bench":"queue","case":"spsc","metric":"throughput","value":12345.000,"unit":"items/s"}
+//   v:      versión del formato (se incrementa si cambian los campos)
+//   target: CONFIG_IDF_TARGET
+//   t_s:    segundos desde el arranque
+//   bench, case, metric: identifican el resultado entre ejecuciones
+//   value:  null si el valor no es finito (nan o inf no son JSON válido)
+//   unit:   en el host no hay contador de ciclos y los tiempos por llamada van en "ns"
+
+#define BENCH_FORMAT_VERSION 1
+
+// Escribe un resultado
+void bench_result(const char *bench, const char *variant, const char *metric, double value, const char *unit);
+
+// Ejecuta todos los microbenchmarks
+void bench_run(void);
+
+// CPU por muestra: lectura oneshot frente a adquisición continua (DMA)
+void bench_therm_acquisition(void);
+
+// Ciclos por llamada de _therm_lsb_to_voltage y _therm_voltage_to_temperature, de la
+// conversión LSB -> °C completa por fórmula (log) frente a tabla, y error máximo de la tabla
+void bench_therm_conversion(void);
+
+// Throughput y latencia Sensor -> consumidor entre núcleos con elementos sensor_data_t:
+// ring buffer (xRingbufferSend/xRingbufferReceive) frente a cola SPSC
+void bench_queue(void);
+
+// Latencia SWITCH_ST -> STATE() y RAM del backend de despacho de system.c seleccionado
+void bench_system_dispatch(void);
+
+// Plazos de una tarea periódica con carga artificial en su núcleo, con prioridades
+// rate-monotonic frente a invertidas, en cada núcleo, junto al resultado del análisis
+void bench_deadline(void);
+
+// Soak del pipeline completo ya arrancado: cada BENCH_SOAK_REPORT_S escribe muestras
+// producidas y consumidas, envíos descartados por cola, transiciones del Checker,
+// plazos (deadline.h), pila libre por tarea y heap libre, durante BENCH_SOAK_S. Crea
+// una tarea de prioridad mínima en CORE1 con los mismos argumentos que Stats, que
+// deben seguir vivos hasta el final. En el host el proceso termina al acabar
+void bench_soak_start(const task_stats_args_t *pipeline);
+
+// Además, INIT escribe el tiempo de creación del pipeline y el heap libre al terminarlo
+// ("startup", "pipeline"), con las mismas claves con STATIC_ALLOCATION 0 y 1
+
+#endif  // __BENCH_H__
@@ -0,0 +1,50 @@
+#ifndef __BOOT_H__
+#define __BOOT_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+
+#include "config.h"
+
+// Arranque del pipeline. Cada tarea marca su bit en un event group cuando sus recursos
+// están listos (ADC, reloj de muestreo, colas) y INIT pasa a SENSOR_LOOP en cuanto
+// están todos, en lugar de esperar un tiempo fijo. Las fases del arranque se fechan
+// con esp_timer (la primera marca de cada fase es la que cuenta) y boot_report() las
+// escribe una vez, al llegar el primer veredicto del Checker.
+
+// Bits de tareas listas
+#define BOOT_READY_SENSOR (1u << 0)
+#define BOOT_READY_CHECKER (1u << 1)
+#define BOOT_READY_MONITOR (1u << 2)
+#define BOOT_READY_STATS (1u << 3)
+
+// Fases del arranque, en el orden en que suelen ocurrir
+typedef enum {
+    BOOT_PHASE_APP_MAIN,       // Entrada en app_main
+    BOOT_PHASE_NVS,            // NVS iniciado
+    BOOT_PHASE_TASKS_STARTED,  // Tareas creadas
+    BOOT_PHASE_TASKS_READY,    // Todas las tareas han marcado su bit
+    BOOT_PHASE_FIRST_SAMPLE,   // Primera muestra de Sensor
+    BOOT_PHASE_FIRST_VERDICT,  // Primer estado publicado por el Checker
+    BOOT_PHASE_COUNT
+} boot_phase_t;
+
+// Crea el event group (en memoria estática). Antes de arrancar las tareas
+void boot_init(void);
+
+// Tarea: sus recursos están listos
+void boot_ready(EventBits_t bit);
+
+// Espera a que todas las tareas de `bits` estén listas; false si vence el plazo
+bool boot_wait_ready(EventBits_t bits, TickType_t ticks_to_wait);
+
+// Fecha una fase si aún no lo estaba (desde cualquier tarea)
+void boot_mark(boot_phase_t phase);
+
+// Escribe las fases fechadas, sólo la primera vez que se llama
+void boot_report(void);
+
+#endif  // __BOOT_H__
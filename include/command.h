@@ -0,0 +1,22 @@
+#ifndef __COMMAND_H__
+#define __COMMAND_H__
+
+#include <esp_err.h>
+
+#include "config.h"
+
+// Órdenes por la consola (la misma UART del log en la placa, stdin en el host). Una
+// tarea de baja prioridad lee la entrada sin bloquear cada COMMAND_POLL_MS, junta
+// una línea y la ejecuta; la respuesta sale por stdout:
+//   rate               periodo de muestreo en vigor
+//   rate <period_us>   cambia el periodo y lo guarda en NVS (sensor_rate_set)
+//   help               lista de órdenes
+
+#if COMMAND_ENABLE
+
+// Crea la tarea de órdenes. rate debe seguir vivo mientras el sistema funcione
+esp_err_t command_init(sensor_rate_t *rate, UBaseType_t priority, BaseType_t core);
+
+#endif  // COMMAND_ENABLE
+
+#endif  // __COMMAND_H__
@@ -14,6 +14,8 @@
 #ifndef __CONFIG_H__
 #define __CONFIG_H__
 
+#include <stdatomic.h>
+
 // freertos
 #include <freertos/FreeRTOS.h>
 #include <freertos/ringbuf.h>
@@ -22,17 +24,30 @@
 #include <hal/adc_types.h>
 
 // propias
+#include "spsc_queue.h"
 #include "system.h"
 
 // Abstracciones para facilitar la legibilidad
+#if CONFIG_IDF_TARGET_LINUX || CONFIG_FREERTOS_UNICORE
+// Un único núcleo (port POSIX de FreeRTOS en el host): todas las tareas en el 0
+#define CORE0 0
+#define CORE1 0
+#else
 #define CORE0 0
 #define CORE1 1
+#endif
 
 // Configuraciones y constantes
-// Sampling frequency in Hz
+// Sampling frequency in Hz (default, until sensor_rate_set() stores another period in NVS)
 #define SENSOR_FREQUENCY 1
-// Number of periods before activating Checker task
+// Number of periods before activating Checker task (at SENSOR_FREQUENCY)
 #define CHECKER_PERIOD 10
+// Intervalo entre lecturas del Checker: se mantiene al cambiar el periodo de muestreo,
+// así que en periodos escala con él (ver sensor_rate.h)
+#define CHECKER_INTERVAL_US ((uint32_t)((uint64_t)CHECKER_PERIOD * 1000000 / SENSOR_FREQUENCY))
+// Límites del periodo de muestreo configurable en tiempo de ejecución
+#define SENSOR_PERIOD_MIN_US 500       // 2 kHz
+#define SENSOR_PERIOD_MAX_US 60000000  // 1 muestra por minuto
 
 // Nombre y estados de la máquina
 #define SYS_NAME "STF P1 System"
@@ -52,11 +67,176 @@ enum {
 #define NOMINAL_RESISTANCE 10000              // 10K ohms
 #define NOMINAL_TEMPERATURE 298.15            // 25°C en Kelvin
 #define BETA_COEFFICIENT 3950                 // Constante B (ajustar según el termistor)
+#define THERM_SETTLE_US 10000                 // Estabilización tras alimentar el divisor (por defecto)
+
+// Grupo de termistores redundantes. El primer canal activo es el primario: siempre
+// alimentado, se lee en cada periodo para el Monitor. Cada CHECKER_INTERVAL_US se
+// leen todos los canales activos en una sola pasada y el Checker vota por mediana
+#define SENSOR_CHANNELS 3
+#define SENSOR_CHANNEL_ADC {ADC_CHANNEL_6, ADC_CHANNEL_7, ADC_CHANNEL_4}  // GPIO34, GPIO35, GPIO32
+#define SENSOR_CHANNEL_POWER_GPIO {THERM1_POWER_GPIO, THERM2_POWER_GPIO, THERM3_POWER_GPIO}
+// Estabilización de cada canal. Sensor enciende los canales secundarios con la antelación
+// (en periodos) necesaria para que estén estables cuando toca leerlos, sin esperar
+#define SENSOR_CHANNEL_SETTLE_US {THERM_SETTLE_US, THERM_SETTLE_US, THERM_SETTLE_US}
+
+// Conversión LSB -> temperatura por tabla (se construye en therm_init, compartida
+// entre termistores con los mismos parámetros). Con THERM_LUT_BITS == 12 hay una
+// entrada por código ADC y el resultado es idéntico a la fórmula; con menos bits
+// se interpola linealmente. Error máximo frente a la fórmula entre -40 y 125°C:
+//   12 bits: 0 (16 KB)   10 bits: 0.005°C (4 KB)   9 bits: 0.018°C (2 KB)   8 bits: 0.068°C (1 KB)
+#define THERM_LUT_ENABLE 1
+#define THERM_LUT_BITS 12
+
+// Modo de adquisición del ADC
+#define THERM_ADC_MODE_ONESHOT 0     // Una conversión bloqueante por muestra
+#define THERM_ADC_MODE_CONTINUOUS 1  // Escaneo DMA de todos los canales
+#define THERM_ADC_MODE THERM_ADC_MODE_ONESHOT
+// Frecuencia de conversión en modo continuo, sumando todos los canales (ESP32: 20 kHz - 2 MHz)
+#define THERM_CONT_SAMPLE_FREQ_HZ 20000
+// Conversiones por trama DMA (máx. 1023 en ESP32). Cada muestra es la media de las
+// tramas de un periodo de muestreo, redondeado a un número entero de tramas
+// (THERM_CONT_FRAME_CONVERSIONS / THERM_CONT_SAMPLE_FREQ_HZ = 50 ms cada una)
+#define THERM_CONT_FRAME_CONVERSIONS 1000
+
+// Filtro de las lecturas de cada canal (ver filter.h)
+#define FILTER_OVERSAMPLE_LOG2 2  // 4 conversiones por lectura en modo oneshot (0 = sin sobremuestreo)
+#define FILTER_MEDIAN_TAPS 3      // Ventana de la mediana móvil (1 = desactivada, máx. 7)
+#define FILTER_IIR_SHIFT 1        // y += (x - y) / 2^SHIFT (0 = desactivado)
+
+// Reloj de muestreo del modo oneshot (ver sample_clock.h). Con ESP_TIMER_TASK el
+// jitter depende de la carga de la tarea esp_timer; ESP_TIMER_ISR y GPTIMER notifican
+// a Sensor desde la interrupción
+#define SAMPLE_CLOCK_ESP_TIMER_TASK 0  // Callback en la tarea esp_timer
+#define SAMPLE_CLOCK_ESP_TIMER_ISR 1   // Callback en la ISR (CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD)
+#define SAMPLE_CLOCK_GPTIMER 2         // Alarma de un GPTimer a 1 MHz
+#if CONFIG_IDF_TARGET_LINUX
+#define SAMPLE_CLOCK_SOURCE SAMPLE_CLOCK_ESP_TIMER_TASK
+#else
+#define SAMPLE_CLOCK_SOURCE SAMPLE_CLOCK_ESP_TIMER_ISR
+#endif
+
+// Termistor simulado (sólo en el target linux, ver therm_sim.h). Todos los canales
+// siguen la misma curva: BASE + AMPLITUDE * sin(2 pi t / PERIOD) + RAMP * t
+#define THERM_SIM_BASE_C 25.0f
+#define THERM_SIM_AMPLITUDE_C 5.0f
+#define THERM_SIM_PERIOD_S 120.0f
+#define THERM_SIM_RAMP_C_PER_S 0.0f
+#define THERM_SIM_NOISE_LSB 3  // Ruido uniforme +-LSB en cada lectura
+// Fallo inyectado al arrancar: T2 deriva 0.1°C/s a partir de los 30 s, por lo que hacia
+// los 55 s el Checker la descarta por votación y sigue en DEGRADED_MODE con T1 y T3
+#define THERM_SIM_FAULT THERM_SIM_FAULT_DRIFT
+#define THERM_SIM_FAULT_CHANNEL ADC_CHANNEL_7
+#define THERM_SIM_FAULT_VALUE 0.1f
+#define THERM_SIM_FAULT_AT_MS 30000
+
+// Benchmarks (ver bench.h): los microbenchmarks se ejecutan en app_main antes de la
+// máquina de estados y el soak, con el pipeline ya en marcha. BENCH_ENABLE se fija al
+// compilar (-DBENCH_ENABLE=1, ver src/CMakeLists.txt)
+#ifndef BENCH_ENABLE
+#define BENCH_ENABLE 0
+#endif
+#define BENCH_ITERATIONS 1000
+#define BENCH_SOAK_S 3600         // Duración del soak (0: sin soak)
+#define BENCH_SOAK_REPORT_S 60    // Intervalo entre informes del soak
+
+// Histogramas de latencia por etapa desde el tick de muestreo (ver latency.h).
+// Con 0 los puntos de captura no generan código
+#define LATENCY_TRACE_ENABLE 0
+#define LATENCY_BUCKETS 24  // Cubetas log2 en us: la última acumula todo lo >= 2^22 us
+
+// Log diferido (ver dlog.h): DLOGx en los bucles de Sensor, Checker y Monitor guarda la
+// entrada sin formatear y la tarea dlog la escribe. Con 0, DLOGx es ESP_LOGx
+#define DLOG_ENABLE 1
+#define DLOG_LEVEL 3                // Nivel máximo registrado (3 = ESP_LOG_INFO)
+#define DLOG_ENTRIES 32             // Entradas por núcleo (potencia de 2, 72 bytes cada una)
+#define DLOG_LINE_SIZE 160          // Línea formateada, se trunca
+#define DLOG_DRAIN_PERIOD_MS 20     // Periodo de vaciado
+#define DLOG_TASK_PRIORITY 0
+#define DLOG_TASK_STACK_SIZE 3072
+
+// Log de muestras y estados en flash (ver flashlog.h), en la partición FLASHLOG_PARTITION
+// de partitions.csv. En el target linux no hay partición
+#if CONFIG_IDF_TARGET_LINUX
+#define FLASHLOG_ENABLE 0
+#else
+#define FLASHLOG_ENABLE 1
+#endif
+#define FLASHLOG_PARTITION "samplelog"
+#define FLASHLOG_QUEUE_PAGES 4        // Páginas en espera de escritura (potencia de 2)
+#define FLASHLOG_FLUSH_MS 30000       // Edad máxima de la página en RAM (0 = sólo páginas llenas)
+#define FLASHLOG_DUMP_AT_BOOT 0       // Volcar el log por la consola al arrancar
+#define FLASHLOG_TASK_PRIORITY 0
+#define FLASHLOG_TASK_STACK_SIZE 3072
+// Espera máxima en esp_restart() a que la tarea de escritura vacíe el log
+#define FLASHLOG_SHUTDOWN_TIMEOUT_MS 1000
+// Periodo con el que la tarea de escritura comprueba si hay que cerrar el log
+#define FLASHLOG_CLOSE_POLL_MS 100
+
+// Órdenes por la consola (ver command.h), p.ej. el periodo de muestreo
+#define COMMAND_ENABLE 1
+#define COMMAND_POLL_MS 100         // Periodo de lectura de la entrada
+#define COMMAND_LINE_SIZE 64        // Longitud máxima de una orden, con el terminador
+#define COMMAND_TASK_PRIORITY 0
+#define COMMAND_TASK_STACK_SIZE 3072
+
+// Telemetría binaria (ver telemetry.h). Con 1 el Monitor deja de imprimir cada muestra
+// y envía registros COBS con CRC por una UART dedicada (en linux, a un fichero); el log
+// de texto sigue en la consola. Para decodificarla: tools/telemetry_decode.py
+#define TELEMETRY_ENABLE 0
+#define TELEMETRY_UART 2             // UART2 (UART0 es la consola)
+#define TELEMETRY_BAUD_RATE 921600
+#define TELEMETRY_TX_GPIO 17
+#define TELEMETRY_RX_GPIO 16         // No se usa, pero el driver necesita un pin
+#define TELEMETRY_TX_BUFFER 4096     // Bytes en cola de transmisión (~44 ms a 921600)
+#define TELEMETRY_LINUX_PATH "telemetry.bin"
+
+// Tramas de muestras entre tareas: el Sensor publica una trama cuando está llena o
+// cuando retenerla un periodo más superaría el plazo de vaciado
+#define SENSOR_BATCH_SIZE 16      // Muestras por trama
+#define SENSOR_BATCH_FLUSH_MS 50  // Tiempo máximo de una muestra dentro de una trama
+// Periodo del informe de despertares ahorrados en Monitor
+#define BATCH_REPORT_PERIOD_MS 10000
+
+// Configuración de las colas SPSC entre tareas (número de tramas, potencia de 2)
+#define QUEUE_LENGTH 8
+
+// Asignación estática del pipeline (ver system.h y spsc_queue.h): pilas, TCB y semáforos
+// de las tareas, semáforos del sistema y almacenamiento de las colas se reservan al
+// enlazar (aparecen en el .map, en .bss) en lugar de tomarse del heap al arrancar.
+// Incluye las tareas auxiliares (dlog, flashlog y su cola, órdenes) y exige
+// SYSTEM_DISPATCH_NOTIFY, porque el bucle de esp_event y su tarea van al heap.
+// El tiempo de creación y el heap libre se registran al final de INIT para comparar
+// (con BENCH_ENABLE también como resultados "startup"). Se fija al compilar
+// (-DSTATIC_ALLOCATION=0, ver src/CMakeLists.txt)
+#ifndef STATIC_ALLOCATION
+#define STATIC_ALLOCATION 1
+#endif
+
+// Plazo de INIT para que las tareas marquen que están listas (ver boot.h)
+#define BOOT_READY_TIMEOUT_MS 2000
 
-// Configuración del buffer cíclico
+// Configuración del buffer cíclico (referencia para los benchmarks de colas)
 #define BUFFER_SIZE 2048
 #define BUFFER_TYPE RINGBUF_TYPE_NOSPLIT
 
+// Canales del grupo que siguen en servicio (bit c = canal c). Lo escribe el Checker
+// al descartar un canal y lo lee Sensor para elegir el primario y los canales a leer
+typedef struct {
+    _Atomic uint8_t active;
+} sensor_group_t;
+
+// Periodo de muestreo en vigor (ver sensor_rate.h): lo escribe sensor_rate_set() desde
+// cualquier tarea y Sensor lo aplica al terminar el periodo en curso
+typedef struct {
+    _Atomic uint32_t period_us;
+} sensor_rate_t;
+
+// Contadores de muestras del pipeline (cada campo tiene un único escritor)
+typedef struct {
+    volatile uint32_t produced;  // Muestras adquiridas por Sensor
+    volatile uint32_t consumed;  // Muestras de Sensor procesadas por Monitor
+} pipeline_counters_t;
+
 // Configuración de las tareas
 
 // SENSOR
@@ -65,44 +245,159 @@ SYSTEM_TASK(TASK_SENSOR);
 // definición de los argumentos que requiere la tarea
 
 typedef struct {
-    RingbufHandle_t *monitor_buf;  // Buffer for Monitor task
-    RingbufHandle_t *checker_buf;  // Buffer for Checker task
-    uint8_t freq;                  // Sampling frequency
-    uint16_t checker_period;       // Periods to activate Checker task
+    spsc_queue_t *monitor_buf;  // Queue for Monitor task
+    spsc_queue_t *checker_buf;  // Queue for Checker task
+    sensor_rate_t *rate;           // Sample period (changes at runtime)
+    uint32_t checker_interval_us;  // Time between Checker reads
+    pipeline_counters_t *counters; // Samples produced
+    sensor_group_t *group;         // Channels in service
+    void (*period_changed)(uint32_t period_us);  // Re-checks the task table for a new period (may be NULL)
 } task_sensor_args_t;
 
 // Timeout de la tarea (ver system_task_stop)
 #define TASK_SENSOR_TIMEOUT_MS 2000
 // Tamaño de la pila de la tarea
 #define TASK_SENSOR_STACK_SIZE 4096
+// Plazos de Sensor (ver deadline.h): un periodo es tardío si la muestra termina después
+// del periodo (contado desde el tick del reloj de muestreo) y perdido si no llega el tick
+// en 1.2 periodos. Periodos seguidos tardíos o perdidos para cada etapa (0: desactivada);
+// un periodo a tiempo vuelve a empezar
+#define DEADLINE_LOG_AFTER 1       // Aviso en el log con el peor retraso
+#define DEADLINE_DEGRADE_AFTER 3   // NORMAL_MODE -> DEGRADED_MODE (el Checker lo devuelve a su veredicto)
+#define DEADLINE_RESTART_AFTER 10  // esp_restart()
+#define DEADLINE_MAX_MONITORS 4
+// Sensor se suscribe al Task Watchdog (TWDT) mientras una espera del bucle quepa en
+// CONFIG_ESP_TASK_WDT_TIMEOUT_S; con periodos más largos se da de baja
+#define DEADLINE_TASK_WDT 1
 
 // MONITOR
 SYSTEM_TASK(TASK_MONITOR);
 // definición de los argumentos que requiere la tarea
 typedef struct
 {
-    RingbufHandle_t *monitor_buf;  // puntero al buffer
-    // ...
+    spsc_queue_t *monitor_buf;          // Cola desde Sensor
+    spsc_queue_t *monitor_checker_buf;  // Cola desde Checker
+    pipeline_counters_t *counters;      // Muestras consumidas
 } task_monitor_args_t;
+// Informe agregado: con un intervalo mayor que 0 el Monitor no escribe una línea por
+// muestra de Sensor sino un resumen por intervalo (muestras, media, mínimo, máximo y,
+// en DEGRADED_MODE, la banda de confianza). Cada muestra se sigue procesando; el
+// intervalo no depende del periodo de muestreo. Con 0, una línea por muestra
+#define MONITOR_REPORT_INTERVAL_MS 0
 // Timeout de la tarea (ver system_task_stop)
 #define TASK_MONITOR_TIMEOUT_MS 2000
 // Tamaño de la pila de la tarea
 #define TASK_MONITOR_STACK_SIZE 4096
 
 // Definición de los pines GPIO
+#if CONFIG_IDF_TARGET_LINUX
+#define THERM1_POWER_GPIO 25
+#define THERM2_POWER_GPIO 26
+#define THERM3_POWER_GPIO 27
+#else
 #define THERM1_POWER_GPIO GPIO_NUM_25
 #define THERM2_POWER_GPIO GPIO_NUM_26
+#define THERM3_POWER_GPIO GPIO_NUM_27
+#endif
 
 // CHECKER
 SYSTEM_TASK(TASK_CHECKER);
+// Umbrales de desviación relativa |T1 - T2| / T1 con histéresis: se entra en
+// DEGRADED_MODE por encima de ENTER y sólo se vuelve a NORMAL_MODE por debajo de EXIT
+#define CHECKER_DEGRADED_ENTER 0.10f
+#define CHECKER_DEGRADED_EXIT 0.08f
+#define CHECKER_ERROR_ENTER 0.20f
+// Muestras consecutivas que deben confirmar un cambio de estado antes de publicarlo
+// (salvo el ERROR de las estadísticas, que ya exige una ventana completa)
+#define CHECKER_CONFIRM_SAMPLES 3
+// Estadísticas de la desviación (ver window_stats.h): NORMAL_MODE y DEGRADED_MODE se
+// deciden con la media exponencial, no con la última muestra. ERROR exige la ventana
+// llena, su media por encima de CHECKER_ERROR_ENTER y ninguna desviación por debajo de
+// CHECKER_DEGRADED_ENTER: un par ruidoso no basta, y un fallo persistente llega a ERROR
+// en WINDOW_STATS_SIZE lecturas (40 s con CHECKER_INTERVAL_US de 10 s)
+#define WINDOW_STATS_SIZE 4           // Muestras del Checker en la ventana (potencia de 2)
+#define WINDOW_STATS_EWMA_ALPHA 0.25f // Peso de la muestra nueva en la media exponencial
+// Con tres o más canales activos cada canal se compara con la mediana del grupo: el
+// que supera CHECKER_DEGRADED_ENTER es un outlier y, confirmado, se descarta (el sistema
+// sigue en DEGRADED_MODE). Sin mayoría que coincida con la mediana se pasa a ERROR.
+// Con dos canales activos se aplica la desviación del par con los umbrales anteriores
+
+// Contadores de transiciones del Checker
+typedef struct {
+    uint32_t posted;      // Cambios de estado publicados en el sistema
+    uint32_t suppressed;  // Veredictos que no generaron publicación (sin cambio o sin confirmar)
+    uint32_t dropped;     // Canales descartados por votación
+} checker_stats_t;
+
 // Definicón de la los argumentos para Checker
 typedef struct {
-    RingbufHandle_t *checker_buf;  // Input buffer from Sensor task
-    RingbufHandle_t *monitor_buf;  // Output buffer to Monitor task
+    spsc_queue_t *checker_buf;  // Input queue from Sensor task
+    spsc_queue_t *monitor_buf;  // Output queue to Monitor task
+    checker_stats_t *stats;     // Transition counters (owned by the caller)
+    sensor_group_t *group;      // Channels in service (the Checker drops outliers)
 } task_checker_args_t;
 
 // Timeout de la tarea (ver system_task_stop)
 #define TASK_CHECKER_TIMEOUT_MS 2000
 // Tamaño de la pila de la tarea
 #define TASK_CHECKER_STACK_SIZE 4096
+
+// STATS
+// Informe periódico de salud del pipeline (opcional, prioridad mínima)
+#define STATS_ENABLE 1
+#define STATS_PERIOD_MS 10000
+// Contadores incluidos en el informe
+#define STATS_CPU (1 << 0)    // Porcentaje de CPU por tarea (requiere CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS)
+#define STATS_STACK (1 << 1)  // Mínimo de pila libre por tarea
+#define STATS_QUEUE (1 << 2)  // Ocupación y envíos fallidos por cola
+#define STATS_RATE (1 << 3)   // Muestras producidas y consumidas por segundo
+#define STATS_CLOCK (1 << 4)  // Jitter del reloj de muestreo (modo oneshot)
+#define STATS_DEADLINE (1 << 5)  // Periodos tardíos y perdidos por tarea (ver deadline.h)
+#define STATS_COUNTERS (STATS_CPU | STATS_STACK | STATS_QUEUE | STATS_RATE | STATS_CLOCK | STATS_DEADLINE)
+#define STATS_MAX_TASKS 4
+#define STATS_MAX_QUEUES 4
+
+SYSTEM_TASK(TASK_STATS);
+// definición de los argumentos que requiere la tarea
+typedef struct {
+    system_task_t *tasks[STATS_MAX_TASKS];     // Tareas observadas
+    size_t ntasks;
+    spsc_queue_t *queues[STATS_MAX_QUEUES];    // Colas observadas
+    const char *queue_names[STATS_MAX_QUEUES];
+    size_t nqueues;
+    pipeline_counters_t *counters;             // Muestras producidas/consumidas
+    checker_stats_t *checker;                  // Transiciones del Checker (opcional)
+    sensor_group_t *group;                     // Canales en servicio (opcional)
+} task_stats_args_t;
+
+// Timeout de la tarea (ver system_task_stop)
+#define TASK_STATS_TIMEOUT_MS (STATS_PERIOD_MS + 1000)
+// Tamaño de la pila de la tarea
+#define TASK_STATS_STACK_SIZE 3072
+
+// TABLA DE TAREAS
+// X(id, función, periodo_us, plazo_us, wcet_us, prioridad, núcleo, pila)
+//   periodo: intervalo mínimo entre activaciones. Sensor y Monitor siguen el periodo de
+//            muestreo (en INIT se toma el guardado en NVS, y si cambia con la orden rate
+//            el Sensor vuelve a asignar prioridades y a comprobar la tabla); el Checker, su intervalo
+//   wcet:    presupuesto de CPU por activación para el análisis de planificabilidad
+//   prioridad: 0 = rate-monotonic (system_rate_monotonic: menor periodo, mayor
+//            prioridad, desde TASK_PRIORITY_BASE); otro valor la fija
+// Sensor va sola en CORE0 con la ISR del reloj de muestreo y la tarea esp_timer
+// (CONFIG_ESP_TIMER_TASK_AFFINITY_CPU0); el resto, en CORE1. main.c arranca las tareas
+// con estos valores y comprueba la planificabilidad en INIT (ver system_schedulable)
+#define TASK_PRIORITY_BASE 1  // Por encima de la tarea idle
+#define SENSOR_DEFAULT_PERIOD_US (1000000 / SENSOR_FREQUENCY)
+
+#define TASK_TABLE_PIPELINE(X)                                                                                       \
+    X(SENSOR, TASK_SENSOR, SENSOR_DEFAULT_PERIOD_US, SENSOR_DEFAULT_PERIOD_US, 2000, 0, CORE0, TASK_SENSOR_STACK_SIZE) \
+    X(CHECKER, TASK_CHECKER, CHECKER_INTERVAL_US, CHECKER_INTERVAL_US, 1000, 0, CORE1, TASK_CHECKER_STACK_SIZE)       \
+    X(MONITOR, TASK_MONITOR, SENSOR_DEFAULT_PERIOD_US, SENSOR_DEFAULT_PERIOD_US, 1000, 0, CORE1, TASK_MONITOR_STACK_SIZE)
+#if STATS_ENABLE
+#define TASK_TABLE_STATS(X) \
+    X(STATS, TASK_STATS, STATS_PERIOD_MS * 1000, STATS_PERIOD_MS * 1000, 20000, 0, CORE1, TASK_STATS_STACK_SIZE)
+#else
+#define TASK_TABLE_STATS(X)
+#endif
+#define TASK_TABLE(X) TASK_TABLE_PIPELINE(X) TASK_TABLE_STATS(X)
 #endif
\ No newline at end of file
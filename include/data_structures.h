@@ -2,17 +2,114 @@
 #ifndef DATA_STRUCTURES_H
 #define DATA_STRUCTURES_H
 
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "config.h"
+
+// Version of the sensor_data_t layout, stored in every record
+#define SENSOR_DATA_VERSION 2
+
 typedef enum {
     DATA_SOURCE_SENSOR,
     DATA_SOURCE_CHECKER
 } data_source_t;
 
-typedef struct {
-    data_source_t source;  // Identify the data source
-    float temperature1;
-    float temperature2;
-    float deviation;  // Deviation calculated by Checker task
-    // Add additional fields if necessary
+// flags: bits 0-1 data_source_t, bits 2-7 mask of the channels holding a reading
+#define SENSOR_FLAG_SOURCE_MASK 0x03
+#define SENSOR_FLAG_CHANNEL_SHIFT 2
+#define SENSOR_FLAG_CHANNELS(mask) ((uint8_t)((mask) << SENSOR_FLAG_CHANNEL_SHIFT))
+
+_Static_assert(SENSOR_CHANNELS >= 2 && SENSOR_CHANNELS <= 6, "the channel mask uses flags bits 2-7");
+
+// Compact sample record (8 + 2 * SENSOR_CHANNELS bytes): 12 bytes with two channels against the
+// 16 of the old float record, 14 with three. Sensor -> Monitor records carry every channel even
+// though only the primary one holds a reading, so that link gains nothing from the extra channels
+typedef struct __attribute__((packed)) {
+    uint32_t timestamp_us;                 // esp_timer_get_time() at the sampling tick, truncated to 32 bits (wraps every ~71 min)
+    uint16_t seq;                          // Sequence number, consecutive on each link
+    uint8_t version;                       // SENSOR_DATA_VERSION
+    uint8_t flags;                         // Source and channel mask
+    int16_t temperature[SENSOR_CHANNELS];  // Centi-degrees Celsius, valid for the channels in flags
 } sensor_data_t;
 
-#endif  // DATA_STRUCTURES_H
\ No newline at end of file
+// Statistics of the Checker deviation over its window (see window_stats.h)
+typedef struct {
+    uint16_t count;  // Samples in the window
+    float mean;
+    float variance;
+    float min;
+    float max;
+    float ewma;      // Exponentially weighted moving average, not windowed
+} window_summary_t;
+
+// Frame of several samples exchanged between tasks in a single queue item
+typedef struct {
+    data_source_t source;     // Task that published the frame
+    uint16_t seq;             // Frame sequence number (per link)
+    uint16_t count;           // Valid samples in the frame
+    window_summary_t window;  // Checker frames: deviation statistics after the last sample
+    sensor_data_t samples[SENSOR_BATCH_SIZE];
+} sensor_frame_t;
+
+// Bytes of a frame up to its last valid sample: the queues copy only these (spsc_queue_set_item_len),
+// so a frame flushed with one sample costs one sample record, not SENSOR_BATCH_SIZE of them
+static inline size_t sensor_frame_size(const void *item) {
+    const sensor_frame_t *frame = (const sensor_frame_t *)item;
+    uint16_t count = frame->count < SENSOR_BATCH_SIZE ? frame->count : SENSOR_BATCH_SIZE;
+    return offsetof(sensor_frame_t, samples) + count * sizeof(sensor_data_t);
+}
+
+// Conversion helpers
+
+// °C -> centi-degrees, rounded and saturated to the int16 range
+static inline int16_t celsius_to_cdeg(float celsius) {
+    float cdeg = roundf(celsius * 100.0f);
+    if (cdeg > INT16_MAX) return INT16_MAX;
+    if (cdeg < INT16_MIN) return INT16_MIN;
+    return (int16_t)cdeg;
+}
+
+static inline float cdeg_to_celsius(int16_t cdeg) {
+    return cdeg * 0.01f;
+}
+
+static inline data_source_t sensor_data_source(const sensor_data_t *data) {
+    return (data_source_t)(data->flags & SENSOR_FLAG_SOURCE_MASK);
+}
+
+// Channels holding a reading
+static inline uint8_t sensor_data_channels(const sensor_data_t *data) {
+    return data->flags >> SENSOR_FLAG_CHANNEL_SHIFT;
+}
+
+// First channel holding a reading (the primary channel in Sensor -> Monitor records)
+static inline uint8_t sensor_data_primary(const sensor_data_t *data) {
+    uint8_t mask = sensor_data_channels(data);
+    return mask ? __builtin_ctz(mask) : 0;
+}
+
+// Relative spread of the readings, (max - min) / primary; with two channels it is |T1 - T2| / T1
+static inline float sensor_data_deviation(const sensor_data_t *data) {
+    uint8_t mask = sensor_data_channels(data);
+    int16_t min = INT16_MAX, max = INT16_MIN;
+    for (uint8_t c = 0; c < SENSOR_CHANNELS; c++) {
+        if (mask & (1u << c)) {
+            if (data->temperature[c] < min) min = data->temperature[c];
+            if (data->temperature[c] > max) max = data->temperature[c];
+        }
+    }
+    if (min > max) {
+        return 0.0f;
+    }
+    return (max - min) * 0.01f / fabsf(cdeg_to_celsius(data->temperature[sensor_data_primary(data)]));
+}
+
+// Distance between two sequence numbers of the same link:
+// 1 in order, > 1 samples were dropped, <= 0 duplicated or reordered
+static inline int16_t sensor_seq_delta(uint16_t prev, uint16_t cur) {
+    return (int16_t)(cur - prev);
+}
+
+#endif  // DATA_STRUCTURES_H
@@ -0,0 +1,56 @@
+#ifndef __DEADLINE_H__
+#define __DEADLINE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "config.h"
+
+// Control de plazos de una tarea periódica. Cada periodo termina de una de tres formas:
+//   - a tiempo: la activación termina dentro del plazo (respuesta <= deadline_us)
+//   - tardío:   termina, pero después del plazo; se guarda el mayor retraso
+//   - perdido:  no llega la activación (timeout de la espera)
+// Los periodos tardíos o perdidos seguidos forman una racha que escala por etapas
+// (DEADLINE_LOG_AFTER, DEADLINE_DEGRADE_AFTER, DEADLINE_RESTART_AFTER en config.h). Cada
+// etapa se devuelve una sola vez por racha, para que la tarea aplique la acción; un
+// periodo a tiempo cierra la racha. Los contadores tienen un único escritor (la tarea
+// controlada) y la tarea Stats los lee sin bloqueo.
+
+// Etapas de escalado, de menor a mayor gravedad
+typedef enum {
+    DEADLINE_OK = 0,    // Nada que hacer
+    DEADLINE_LOG,       // Avisar en el log
+    DEADLINE_DEGRADE,   // Pasar a DEGRADED_MODE
+    DEADLINE_RESTART,   // Reiniciar
+} deadline_stage_t;
+
+typedef struct {
+    const char *name;                    // Nombre de la tarea (literal)
+    uint32_t deadline_us;                // Plazo relativo a la activación
+    volatile uint32_t activations;       // Periodos completados (a tiempo o tarde)
+    volatile uint32_t late;              // Periodos completados después del plazo
+    volatile uint32_t missed;            // Periodos sin activación
+    volatile uint32_t worst_overrun_us;  // Mayor retraso sobre el plazo desde el arranque
+    uint32_t consecutive;                // Periodos seguidos tardíos o perdidos
+    deadline_stage_t stage;              // Etapa alcanzada en la racha actual
+} deadline_monitor_t;
+
+// Pone a cero los contadores y registra el control para deadline_get() (una vez por
+// objeto: volver a iniciarlo al rearrancar la tarea no lo duplica). El objeto debe
+// sobrevivir a la tarea (estático)
+void deadline_init(deadline_monitor_t *dm, const char *name, uint32_t deadline_us);
+
+// Cambia el plazo (p.ej. al cambiar el periodo); los contadores se mantienen
+void deadline_set(deadline_monitor_t *dm, uint32_t deadline_us);
+
+// La activación ha terminado response_us después de su instante de liberación
+deadline_stage_t deadline_complete(deadline_monitor_t *dm, uint32_t response_us);
+
+// Ha vencido la espera sin activación
+deadline_stage_t deadline_miss(deadline_monitor_t *dm);
+
+// Controles registrados (hasta DEADLINE_MAX_MONITORS), para los informes
+size_t deadline_count(void);
+const deadline_monitor_t *deadline_get(size_t index);
+
+#endif  // __DEADLINE_H__
@@ -0,0 +1,110 @@
+#ifndef __DLOG_H__
+#define __DLOG_H__
+
+#include <esp_err.h>
+#include <esp_log.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "config.h"
+
+// Log diferido. DLOGx(tag, fmt, ...) se usa como ESP_LOGx, pero en el punto de llamada
+// sólo guarda el puntero al formato, el tag, el instante y los argumentos en crudo en
+// un buffer circular del núcleo que llama (lock-free: varias tareas del mismo núcleo
+// reservan entrada con CAS). Una tarea de baja prioridad formatea las entradas, en
+// orden de instante entre núcleos, y las escribe con esp_log_write(). Si el buffer está
+// lleno la entrada se descarta y se cuenta; nunca se bloquea.
+// Restricciones frente a ESP_LOGx:
+//   - formato y argumentos %s deben seguir vivos cuando se vacía el buffer (literales
+//     o cadenas estáticas, nunca buffers en la pila)
+//   - como mucho DLOG_MAX_ARGS argumentos; '*' en anchura o precisión no se admite
+//   - el nivel se filtra al compilar con DLOG_LEVEL (y después, en esp_log_write, con
+//     el nivel del tag en tiempo de ejecución)
+//   - las entradas pendientes se pierden con esp_restart() o un pánico: lo que se
+//     registre justo antes de reiniciar o de parar el sistema va con ESP_LOGx
+
+#define DLOG_MAX_ARGS 6
+
+#if DLOG_ENABLE
+
+// Crea la tarea que vacía los buffers. Las entradas registradas antes se conservan
+esp_err_t dlog_init(UBaseType_t priority, BaseType_t core);
+
+// Guarda una entrada (usar las macros DLOGx)
+void dlog_write(esp_log_level_t level, const char *tag, const char *fmt, const uint64_t *args, uint8_t nargs);
+
+// Entradas descartadas por buffer lleno desde el arranque, sumando todos los núcleos
+uint32_t dlog_dropped(void);
+
+// Conversión de cada argumento a 64 bits según su tipo: los enteros con su signo, los
+// reales como double (como en una llamada variádica) y los punteros como dirección
+// (los punteros que no sean a char o void necesitan un cast a void *)
+static inline uint64_t dlog_arg_int(long long value) {
+    return (uint64_t)value;
+}
+
+static inline uint64_t dlog_arg_uint(unsigned long long value) {
+    return value;
+}
+
+static inline uint64_t dlog_arg_double(double value) {
+    uint64_t raw;
+    memcpy(&raw, &value, sizeof(raw));
+    return raw;
+}
+
+static inline uint64_t dlog_arg_ptr(const void *value) {
+    return (uintptr_t)value;
+}
+
+#define DLOG_ARG(x) _Generic((x),                                         \
+    float: dlog_arg_double, double: dlog_arg_double,                      \
+    char *: dlog_arg_ptr, const char *: dlog_arg_ptr,                     \
+    void *: dlog_arg_ptr, const void *: dlog_arg_ptr,                     \
+    unsigned long: dlog_arg_uint, unsigned long long: dlog_arg_uint,      \
+    default: dlog_arg_int)(x)
+
+// Número de argumentos (hasta 8, para que el _Static_assert detecte los que sobran)
+#define DLOG_NARGS(...) DLOG_NARGS_(0, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define DLOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, N, ...) N
+
+#define DLOG_CAT(a, b) DLOG_CAT_(a, b)
+#define DLOG_CAT_(a, b) a##b
+#define DLOG_ARGS_0() 0
+#define DLOG_ARGS_1(a) DLOG_ARG(a)
+#define DLOG_ARGS_2(a, ...) DLOG_ARG(a), DLOG_ARGS_1(__VA_ARGS__)
+#define DLOG_ARGS_3(a, ...) DLOG_ARG(a), DLOG_ARGS_2(__VA_ARGS__)
+#define DLOG_ARGS_4(a, ...) DLOG_ARG(a), DLOG_ARGS_3(__VA_ARGS__)
+#define DLOG_ARGS_5(a, ...) DLOG_ARG(a), DLOG_ARGS_4(__VA_ARGS__)
+#define DLOG_ARGS_6(a, ...) DLOG_ARG(a), DLOG_ARGS_5(__VA_ARGS__)
+#define DLOG_ARGS_7(a, ...) DLOG_ARG(a), DLOG_ARGS_6(__VA_ARGS__)
+#define DLOG_ARGS_8(a, ...) DLOG_ARG(a), DLOG_ARGS_7(__VA_ARGS__)
+
+#define DLOG_LEVEL_WRITE(level, tag, fmt, ...)                                                    \
+    do {                                                                                          \
+        if ((level) <= DLOG_LEVEL) {                                                              \
+            _Static_assert(DLOG_NARGS(__VA_ARGS__) <= DLOG_MAX_ARGS, "too many DLOG arguments"); \
+            const uint64_t _dlog_args[DLOG_NARGS(__VA_ARGS__) + 1] = {                            \
+                DLOG_CAT(DLOG_ARGS_, DLOG_NARGS(__VA_ARGS__))(__VA_ARGS__)};                      \
+            dlog_write((level), (tag), (fmt), _dlog_args, DLOG_NARGS(__VA_ARGS__));               \
+        }                                                                                         \
+    } while (0)
+
+#define DLOGE(tag, fmt, ...) DLOG_LEVEL_WRITE(ESP_LOG_ERROR, tag, fmt, ##__VA_ARGS__)
+#define DLOGW(tag, fmt, ...) DLOG_LEVEL_WRITE(ESP_LOG_WARN, tag, fmt, ##__VA_ARGS__)
+#define DLOGI(tag, fmt, ...) DLOG_LEVEL_WRITE(ESP_LOG_INFO, tag, fmt, ##__VA_ARGS__)
+#define DLOGD(tag, fmt, ...) DLOG_LEVEL_WRITE(ESP_LOG_DEBUG, tag, fmt, ##__VA_ARGS__)
+#define DLOGV(tag, fmt, ...) DLOG_LEVEL_WRITE(ESP_LOG_VERBOSE, tag, fmt, ##__VA_ARGS__)
+
+#else
+
+// Sin log diferido las macros son ESP_LOGx
+#define DLOGE(tag, fmt, ...) ESP_LOGE(tag, fmt, ##__VA_ARGS__)
+#define DLOGW(tag, fmt, ...) ESP_LOGW(tag, fmt, ##__VA_ARGS__)
+#define DLOGI(tag, fmt, ...) ESP_LOGI(tag, fmt, ##__VA_ARGS__)
+#define DLOGD(tag, fmt, ...) ESP_LOGD(tag, fmt, ##__VA_ARGS__)
+#define DLOGV(tag, fmt, ...) ESP_LOGV(tag, fmt, ##__VA_ARGS__)
+
+#endif  // DLOG_ENABLE
+
+#endif  // __DLOG_H__
@@ -0,0 +1,39 @@
+#ifndef __FILTER_H__
+#define __FILTER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "therm.h"
+
+// Filtro de las lecturas de un canal, en aritmética entera. Cadena:
+//   sobremuestreo (2^FILTER_OVERSAMPLE_LOG2 conversiones, sólo en filter_read)
+//   -> decimación a Q4 (LSB * 16) -> mediana móvil de FILTER_MEDIAN_TAPS
+//   -> IIR de un polo y += (x - y) / 2^FILTER_IIR_SHIFT -> LSB redondeado
+// El estado es por canal y debe reiniciarse cada vez que el termistor se alimenta:
+// tras filter_reset() la mediana y el IIR dejan pasar la primera lectura sin retardo,
+// así que un canal que se enciende para una sola lectura sólo se beneficia del
+// sobremuestreo.
+
+// Bits fraccionarios de las lecturas dentro del filtro
+#define FILTER_Q 4
+
+typedef struct {
+    uint16_t window[FILTER_MEDIAN_TAPS];  // Últimas lecturas (Q4), circular
+    uint8_t count;                        // Lecturas en la ventana
+    uint8_t pos;                          // Próxima posición a escribir
+    int32_t iir;                          // Estado del IIR, Q4 << FILTER_IIR_SHIFT
+    bool primed;                          // El IIR tiene estado
+} filter_t;
+
+// Vacía el estado (al alimentar el termistor)
+void filter_reset(filter_t* filter);
+
+// Filtra una lectura en Q4 (p. ej. la media de una trama DMA << FILTER_Q) y devuelve el LSB
+uint16_t filter_update(filter_t* filter, uint16_t q4);
+
+// Lee 2^FILTER_OVERSAMPLE_LOG2 conversiones del termistor, las decima a Q4 y las filtra
+uint16_t filter_read(filter_t* filter, therm_t thermistor);
+
+#endif  // __FILTER_H__
@@ -0,0 +1,96 @@
+#ifndef __FLASHLOG_H__
+#define __FLASHLOG_H__
+
+#include <esp_err.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "data_structures.h"
+
+// Log circular de muestras y cambios de estado en la partición FLASHLOG_PARTITION
+// (ver partitions.csv), que sobrevive a un ERROR o a un reinicio.
+//
+// Los registros se agrupan en RAM en páginas de FLASHLOG_PAGE_SIZE bytes (la página de
+// programación de la flash). Una página llena pasa por una cola SPSC a la tarea de
+// escritura, de baja prioridad, que borra el sector cuando entra en él y programa la
+// página: el productor (init y después el Monitor) nunca espera a la flash. Si la cola
+// está llena la página se descarta y se cuenta. Mientras la flash se programa o se
+// borra la caché está desactivada y las tareas que no estén en IRAM se detienen en
+// ambos núcleos, así que cada operación se limita a una página (~0.7 ms) o se trocea
+// (borrado de un sector: ~45 ms en tramos de CONFIG_SPI_FLASH_ERASE_YIELD_DURATION_MS).
+//
+// Cada página lleva número de secuencia, arranque y CRC32. Al iniciar se recorre la
+// partición, la página válida de mayor secuencia marca el final del log y la escritura
+// continúa en la siguiente página en blanco; las páginas a medio escribir por un corte
+// de alimentación no pasan el CRC y se ignoran.
+//
+// En esp_restart() un manejador de apagado detiene al productor, y la tarea de escritura
+// vacía la cola y escribe la página en construcción antes del reinicio (como mucho
+// FLASHLOG_SHUTDOWN_TIMEOUT_MS). Un pánico o un corte pierden lo que esté en RAM.
+//
+// Capacidad y desgaste con la partición de 960 KB (240 sectores, 3840 páginas de 30
+// registros, 115200 registros por vuelta; cada vuelta borra cada sector una vez):
+//   1 muestra/s:    una página cada 30 s, vuelta de 32 h,  100k ciclos -> ~365 años
+//   100 muestras/s: una página cada 0.3 s, vuelta de 19 min, 100k ciclos -> ~3.6 años
+// Escritura sostenida: un sector (480 registros) cuesta ~45 ms de borrado + 16 x 0.7 ms
+// de programación, ~8500 registros/s típicos; en el peor caso de la flash (borrado de
+// 400 ms, programación de 3 ms) ~1000 registros/s.
+
+// Tipos de registro
+typedef enum {
+    FLASHLOG_SAMPLE = 1,  // arg = canal, value = temperatura en cdeg
+    FLASHLOG_STATE = 2,   // arg = estado anterior, value = estado nuevo
+    FLASHLOG_BOOT = 3,    // arg = esp_reset_reason(), value = número de arranque
+} flashlog_type_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t time_ms;  // Desde el arranque
+    uint8_t type;      // flashlog_type_t
+    uint8_t arg;
+    int16_t value;
+} flashlog_record_t;
+
+#define FLASHLOG_PAGE_SIZE 256
+#define FLASHLOG_SECTOR_SIZE 4096
+#define FLASHLOG_PAGE_RECORDS 30  // (256 - 16 de cabecera) / 8
+
+// Recorrido del log: se llama una vez por registro, del más antiguo al más reciente
+typedef void (*flashlog_visit_t)(uint16_t boot, const flashlog_record_t *record, void *ctx);
+
+#if FLASHLOG_ENABLE
+
+// Busca la partición, recupera el final del log, añade el registro FLASHLOG_BOOT, crea
+// la tarea de escritura y registra el manejador de esp_restart(). Sin partición devuelve ESP_ERR_NOT_FOUND y el resto de
+// funciones no hacen nada
+esp_err_t flashlog_init(UBaseType_t priority, BaseType_t core);
+
+// Productor (una sola tarea): añaden un registro a la página en RAM
+void flashlog_sample(const sensor_data_t *data);
+void flashlog_state(uint8_t from, uint8_t to);
+
+// Productor: envía la página en curso aunque no esté llena (antes de parar; al
+// reiniciar con esp_restart() no hace falta)
+void flashlog_flush(void);
+
+// Recorre el log guardado en flash (no incluye lo que aún esté en RAM)
+esp_err_t flashlog_foreach(flashlog_visit_t visit, void *ctx);
+
+// Vuelca el log por la consola en CSV: boot,time_ms,type,arg,value
+void flashlog_dump(void);
+
+// Páginas descartadas por cola llena o error de escritura
+uint32_t flashlog_dropped(void);
+
+#define FLASHLOG_SAMPLE_RECORD(data) flashlog_sample(data)
+#define FLASHLOG_STATE_RECORD(from, to) flashlog_state((from), (to))
+#define FLASHLOG_FLUSH() flashlog_flush()
+
+#else
+
+#define FLASHLOG_SAMPLE_RECORD(data) ((void)0)
+#define FLASHLOG_STATE_RECORD(from, to) ((void)0)
+#define FLASHLOG_FLUSH() ((void)0)
+
+#endif  // FLASHLOG_ENABLE
+
+#endif  // __FLASHLOG_H__
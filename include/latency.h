@@ -0,0 +1,49 @@
+#ifndef __LATENCY_H__
+#define __LATENCY_H__
+
+#include <stdint.h>
+
+#include "config.h"
+
+// Latencia de las muestras a lo largo del pipeline. Cada punto de captura acumula,
+// en un histograma log2 propio, el tiempo transcurrido desde el tick de muestreo
+// (timestamp_us de la muestra) hasta esa etapa, de modo que cada etapa incluye a las
+// anteriores y la última es la latencia extremo a extremo.
+// Cada etapa la escribe una sola tarea, así que el registro no usa cerrojos;
+// latency_dump() lee los contadores sin detenerlas (una muestra puede aparecer
+// contada y no sumada en el máximo, sin más efecto).
+
+typedef enum {
+    LATENCY_SENSOR_READ,     // Tick -> conversión de T1 terminada
+    LATENCY_SENSOR_SEND,     // Tick -> trama publicada hacia Monitor/Checker
+    LATENCY_CHECKER_IN,      // Tick -> trama recibida en el Checker
+    LATENCY_CHECKER_OUT,     // Tick -> trama del Checker publicada hacia Monitor
+    LATENCY_MONITOR_IN,      // Tick -> trama del Sensor recibida en el Monitor
+    LATENCY_MONITOR_CHK_IN,  // Tick -> trama del Checker recibida en el Monitor
+    LATENCY_MONITOR_OUT,     // Tick -> muestra del Sensor procesada (y registrada) por el Monitor
+    LATENCY_POINTS
+} latency_point_t;
+
+#if LATENCY_TRACE_ENABLE
+
+// Añade al histograma de la etapa el tiempo desde t0_us (reloj esp_timer, 32 bits)
+void latency_record(latency_point_t point, uint32_t t0_us);
+
+// Publica por el log, para cada etapa, número de muestras, p50, p99 y máximo
+// (los percentiles son el límite superior de su cubeta)
+void latency_dump(void);
+
+// Vacía todos los histogramas
+void latency_reset(void);
+
+#define LATENCY_RECORD(point, t0_us) latency_record((point), (t0_us))
+#define LATENCY_DUMP() latency_dump()
+
+#else
+
+#define LATENCY_RECORD(point, t0_us) ((void)0)
+#define LATENCY_DUMP() ((void)0)
+
+#endif  // LATENCY_TRACE_ENABLE
+
+#endif  // __LATENCY_H__
@@ -0,0 +1,44 @@
+#ifndef __SAMPLE_CLOCK_H__
+#define __SAMPLE_CLOCK_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <esp_err.h>
+#include <freertos/FreeRTOS.h>
+
+// Reloj de muestreo del modo oneshot. Cada tick notifica directamente a la tarea que
+// arrancó el reloj (sin semáforo intermedio); según SAMPLE_CLOCK_SOURCE el tick se
+// genera en la tarea esp_timer, en la ISR de esp_timer o en la ISR de un GPTimer.
+// sample_clock_wait() mide el intervalo entre despertares consecutivos de la tarea,
+// que es el instante real de muestreo, y cuenta los ticks perdidos.
+
+// Estadísticas de jitter desde el último reset
+typedef struct {
+    uint32_t intervals;    // Intervalos medidos
+    uint32_t missed;       // Ticks que llegaron sin que la tarea hubiese atendido el anterior
+    uint32_t min_us;       // Intervalo mínimo entre despertares
+    uint32_t max_us;       // Intervalo máximo entre despertares
+    float mean_us;
+    float stddev_us;
+    uint32_t max_wake_us;  // Retardo máximo tick -> despertar de la tarea
+} sample_clock_jitter_t;
+
+// Arranca el reloj con periodo period_us; los ticks se notifican a la tarea que llama
+esp_err_t sample_clock_start(uint32_t period_us);
+
+// Espera al siguiente tick. Devuelve false si no llega antes de timeout; si no, deja en
+// tick_us el instante del tick (esp_timer, 32 bits)
+bool sample_clock_wait(TickType_t timeout, uint32_t* tick_us);
+
+esp_err_t sample_clock_stop(void);
+
+// Cambia el periodo sin parar el reloj: el siguiente tick llega period_us después de
+// la llamada. Sólo desde la tarea que arrancó el reloj; descarta el tick pendiente, si
+// lo hay, y empieza una nueva ventana de jitter
+esp_err_t sample_clock_set_period(uint32_t period_us);
+
+// Copia las estadísticas de jitter y, si reset, empieza una nueva ventana
+void sample_clock_jitter(sample_clock_jitter_t* jitter, bool reset);
+
+#endif  // __SAMPLE_CLOCK_H__
@@ -0,0 +1,24 @@
+#ifndef __SENSOR_RATE_H__
+#define __SENSOR_RATE_H__
+
+#include <esp_err.h>
+#include <stdint.h>
+
+#include "config.h"
+
+// Periodo de muestreo configurable en tiempo de ejecución. sensor_rate_set() puede
+// llamarse desde cualquier tarea: guarda el periodo en NVS y Sensor lo aplica al
+// terminar el periodo en curso, sin pararse (rearma el reloj de muestreo y el watchdog
+// y recalcula cada cuántos periodos se lee para el Checker, que mantiene su intervalo
+// CHECKER_INTERVAL_US). En modo continuo el periodo se redondea a un número entero de
+// tramas DMA, que se promedian en cada muestra. En ejecución se cambia con la orden
+// de consola "rate <period_us>" (ver command.h).
+
+// Lee el periodo guardado en NVS (SENSOR_FREQUENCY si no hay ninguno). Requiere NVS iniciado
+esp_err_t sensor_rate_load(sensor_rate_t *rate);
+
+// Cambia el periodo y lo guarda en NVS. ESP_ERR_INVALID_ARG fuera de
+// [SENSOR_PERIOD_MIN_US, SENSOR_PERIOD_MAX_US]
+esp_err_t sensor_rate_set(sensor_rate_t *rate, uint32_t period_us);
+
+#endif  // __SENSOR_RATE_H__
@@ -0,0 +1,77 @@
+#ifndef __SPSC_QUEUE_H__
+#define __SPSC_QUEUE_H__
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <esp_err.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// Cola lock-free de un productor y un consumidor para registros de tamaño fijo.
+// Los índices head/tail son contadores monótonos de 32 bits (la capacidad es potencia
+// de 2), cada extremo escribe sólo su índice y publica con release/acquire, por lo que
+// productor y consumidor pueden estar en núcleos distintos. El consumidor duerme en su
+// notificación de tarea y el productor sólo le notifica si está esperando.
+
+// Separación entre los campos del productor y los del consumidor
+#define SPSC_QUEUE_ALIGN 32
+
+typedef struct {
+    // Productor
+    _Alignas(SPSC_QUEUE_ALIGN) _Atomic uint32_t head;  // Próxima posición a escribir
+    uint32_t tail_cache;                               // Última tail leída por el productor
+    uint32_t drops;                                    // Envíos rechazados por cola llena
+
+    // Consumidor
+    _Alignas(SPSC_QUEUE_ALIGN) _Atomic uint32_t tail;  // Próxima posición a leer
+    uint32_t head_cache;                               // Última head leída por el consumidor
+    _Atomic bool waiting;                              // El consumidor va a bloquearse
+    _Atomic(TaskHandle_t) consumer;                    // Tarea a notificar
+
+    // Configuración (constante tras spsc_queue_create)
+    _Alignas(SPSC_QUEUE_ALIGN) uint8_t *storage;
+    uint32_t mask;
+    uint32_t item_size;
+    size_t (*item_len)(const void *item);  // Bytes útiles de un registro (NULL: item_size)
+    bool static_storage;                   // storage lo aporta quien crea la cola
+} spsc_queue_t;
+
+// Almacenamiento estático de una cola de `capacity` registros de tipo `type`
+#define SPSC_QUEUE_STORAGE(name, type, capacity) \
+    static _Alignas(SPSC_QUEUE_ALIGN) uint8_t name[sizeof(type) * (capacity)]
+
+// Crea una cola de `capacity` registros (potencia de 2) de `item_size` bytes
+esp_err_t spsc_queue_create(spsc_queue_t *q, size_t item_size, size_t capacity);
+// Igual, sobre `storage` (item_size * capacity bytes alineados a SPSC_QUEUE_ALIGN,
+// ver SPSC_QUEUE_STORAGE): no usa el heap
+esp_err_t spsc_queue_create_static(spsc_queue_t *q, size_t item_size, size_t capacity, uint8_t *storage);
+void spsc_queue_delete(spsc_queue_t *q);
+// Registros de longitud variable: send y pop copian sólo los `item_len(item)` primeros bytes
+// (como mucho item_size) en lugar del hueco entero. Antes del primer envío
+void spsc_queue_set_item_len(spsc_queue_t *q, size_t (*item_len)(const void *item));
+
+// Productor: copia el registro en la cola. No bloquea; false si está llena
+bool spsc_queue_send(spsc_queue_t *q, const void *item);
+
+// Consumidor: extrae un registro sin bloquear
+bool spsc_queue_pop(spsc_queue_t *q, void *item);
+// Consumidor: extrae un registro esperando como mucho `ticks_to_wait`; false sólo si vence
+// la espera (con portMAX_DELAY no vuelve sin registro)
+bool spsc_queue_receive(spsc_queue_t *q, void *item, TickType_t ticks_to_wait);
+// Consumidor: espera a que cualquiera de las colas tenga datos (todas consumidas por la tarea
+// actual); false sólo si vence la espera. Otras notificaciones a la tarea no la terminan
+bool spsc_queue_wait(spsc_queue_t *const *queues, size_t count, TickType_t ticks_to_wait);
+
+// Ocupación aproximada (puede leerse desde cualquier tarea)
+static inline uint32_t spsc_queue_count(const spsc_queue_t *q) {
+    return atomic_load_explicit(&q->head, memory_order_relaxed) - atomic_load_explicit(&q->tail, memory_order_relaxed);
+}
+
+static inline uint32_t spsc_queue_capacity(const spsc_queue_t *q) {
+    return q->mask + 1;
+}
+
+#endif  // __SPSC_QUEUE_H__
@@ -7,11 +7,21 @@
  *
  * PUBLIC FUNCTIONS :
  *       system_create
+ *       system_create_static
  *       system_register_state
  *       system_set_default_state
  *       system_task_start
  *       system_task_start_in_core
+ *       system_task_start_in_core_static
  *		system_task_stop
+ *       system_task_handle_take/system_task_handle_give
+ *       system_task_watchdog
+ *       system_rate_monotonic
+ *       system_schedulable
+ *       system_register_state_hooks
+ *       system_wait_state
+ *       system_switch_state
+ *       system_delete
  *
  * MACROS:
  *		STATE_MACHINE(system)
@@ -19,9 +29,11 @@
  *		STATE(state)
  *		STATE_BEGIN()/STATE_END()
  *       SYSTEM_TASK(task)
+ *       SYSTEM_TASK_STACK(name, stack_depth)
  *		TASK_BEGIN()/TASK_END()
  *		TASK_ARGS
  *		TASK_LOOP()
+ *       system_task_feed(task)
  *		SWITCH_ST_FROM_TASK(state)
  *		GET_ST_FROM_TASK()
  *
@@ -40,17 +52,49 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/semphr.h>
 #include <freertos/task.h>
+#include <stdbool.h>
+#if CONFIG_ESP_TASK_WDT_EN
+#include <esp_task_wdt.h>
+#endif
+
+// state dispatch backends (select at build time with -DSYSTEM_DISPATCH=...)
+#define SYSTEM_DISPATCH_EVENT_LOOP 0  // esp_event loop task + binary semaphore
+#define SYSTEM_DISPATCH_NOTIFY 1      // direct task notification to the state machine task
+
+#ifndef SYSTEM_DISPATCH
+#define SYSTEM_DISPATCH SYSTEM_DISPATCH_EVENT_LOOP
+#endif
+
+// maximum number of states of a system (size of the static state table)
+#define SYSTEM_MAX_STATES 16
+
+// state entry/exit hook, run by the state machine task
+typedef void (*system_state_hook_t)(void *arg);
+
+// state table entry
+typedef struct
+{
+    system_state_hook_t on_entry;  // run before the STATE() body when the state is entered
+    system_state_hook_t on_exit;   // run when the state is left
+    void *arg;                     // hook argument
+} system_state_desc_t;
 
 // system
 typedef struct
 {
-    char sys_id[16];                          // system id
-    SemaphoreHandle_t sys_st_mutex;           // mutex to change the system state
-    SemaphoreHandle_t sys_new_state;          // lock to wait a new state
-    uint8_t sys_state;                        // system current state
-    uint8_t sys_nstates;                      // number of states
-    esp_event_loop_handle_t sys_evt_loop;     // system event loop handler
-    esp_event_loop_args_t sys_evt_loop_args;  // system event loop configuration
+    char sys_id[16];                                     // system id
+    SemaphoreHandle_t sys_st_mutex;                      // mutex to change the system state
+    uint8_t sys_state;                                   // system current state
+    uint8_t sys_nstates;                                 // number of states
+    uint8_t sys_run_state;                               // state last run by the state machine
+    system_state_desc_t sys_states[SYSTEM_MAX_STATES];  // static state table
+#if SYSTEM_DISPATCH == SYSTEM_DISPATCH_NOTIFY
+    TaskHandle_t sys_owner;                              // task running the state machine
+#else
+    SemaphoreHandle_t sys_new_state;                     // lock to wait a new state
+    esp_event_loop_handle_t sys_evt_loop;                // system event loop handler
+    esp_event_loop_args_t sys_evt_loop_args;             // system event loop configuration
+#endif
 } system_t;
 
 // system tasks
@@ -60,11 +104,51 @@ typedef struct
     SemaphoreHandle_t sys_task_stop;
     TaskHandle_t sys_task_handler;
     void *sys_task_args;
+    volatile bool sys_task_wdt;  // subscribed to the Task Watchdog (see system_task_watchdog)
 } system_task_t;
 
+// caller-provided storage of a system created with system_create_static
+typedef struct
+{
+    StaticSemaphore_t sys_st_mutex;
+#if SYSTEM_DISPATCH == SYSTEM_DISPATCH_EVENT_LOOP
+    StaticSemaphore_t sys_new_state;
+#endif
+} system_buffers_t;
+
+// caller-provided storage of a task started with system_task_start_in_core_static
+typedef struct
+{
+    StaticTask_t sys_task_tcb;
+    StaticSemaphore_t sys_task_stop;
+} system_task_buffers_t;
+
+// timing of a periodic (or sporadic) task, for rate-monotonic priorities and the schedulability check
+typedef struct
+{
+    const char *name;
+    uint32_t period_us;                  // minimum time between activations
+    uint32_t deadline_us;                // relative deadline, at most the period
+    uint32_t wcet_us;                    // worst-case execution time of one activation (budget)
+    UBaseType_t priority;                // 0: assigned by system_rate_monotonic
+    BaseType_t core;                     // core the task is pinned to
+    configSTACK_DEPTH_TYPE stack_depth;  // stack size in bytes
+} system_task_timing_t;
+
+// Task Watchdog timeout: a subscribed task must go through TASK_LOOP at least this often (0: no TWDT)
+#if CONFIG_ESP_TASK_WDT_EN
+#define SYSTEM_TASK_WDT_TIMEOUT_US ((uint32_t)CONFIG_ESP_TASK_WDT_TIMEOUT_S * 1000000)
+#else
+#define SYSTEM_TASK_WDT_TIMEOUT_US 0
+#endif
+
+// stack of a static task, stack_depth in bytes as in system_task_start_in_core
+#define SYSTEM_TASK_STACK(name, stack_depth) static StackType_t name[(stack_depth) / sizeof(StackType_t)]
+
 /**
  * The function `system_create` creates a system object with a given ID and initializes its mutexes and
- * event loop.
+ * event loop. With SYSTEM_DISPATCH_NOTIFY no event loop is created and the calling task becomes the
+ * owner of the state machine (it must be the task that runs STATE_MACHINE).
  *
  * @param sys A pointer to a structure of type system_t, which represents the system being created.
  * @param id The id parameter is a string that represents the unique identifier for the system. It is
@@ -73,6 +157,17 @@ typedef struct
  */
 void system_create(system_t *sys, const char *id);
 
+/**
+ * The function `system_create_static` is `system_create` with the semaphores placed in caller-provided
+ * storage, so they take no heap. With SYSTEM_DISPATCH_EVENT_LOOP the event loop and its task are still
+ * allocated by esp_event (it has no static variant); with SYSTEM_DISPATCH_NOTIFY nothing is allocated.
+ *
+ * @param sys A pointer to the system structure being created.
+ * @param id The system id, as in `system_create`.
+ * @param buffers Storage for the semaphores. It must outlive the system (static or global).
+ */
+void system_create_static(system_t *sys, const char *id, system_buffers_t *buffers);
+
 // system add state
 /**
  * The function `system_register_state` registers a system state with an event loop and increments the
@@ -84,6 +179,19 @@ void system_create(system_t *sys, const char *id);
  */
 void system_register_state(system_t *sys, uint8_t st);
 
+/**
+ * The function `system_register_state_hooks` sets optional entry and exit hooks for a registered state.
+ * Hooks run in the state machine task, before the STATE() body of the new state.
+ *
+ * @param sys A pointer to the system structure.
+ * @param st The state the hooks belong to.
+ * @param on_entry Hook run when the state is entered (may be NULL).
+ * @param on_exit Hook run when the state is left (may be NULL).
+ * @param arg Argument passed to both hooks.
+ */
+void system_register_state_hooks(system_t *sys, uint8_t st, system_state_hook_t on_entry,
+                                 system_state_hook_t on_exit, void *arg);
+
 // system set default state
 /**
  * The function sets the default state of a system and gives a semaphore if it is not already taken.
@@ -133,6 +241,27 @@ void system_task_start(system_t *sys, system_task_t *task, TaskFunction_t functi
 void system_task_start_in_core(system_t *sys, system_task_t *task, TaskFunction_t function, const char *const name,
                                configSTACK_DEPTH_TYPE stack_depth, void *args, UBaseType_t priority, BaseType_t coreid);
 
+/**
+ * The function `system_task_start_in_core_static` is `system_task_start_in_core` with the stack, the
+ * task control block and the stop semaphore placed in caller-provided storage, so the task takes no
+ * heap. `system_task_stop` works the same on both kinds of task.
+ *
+ * @param sys A pointer to the system structure.
+ * @param task A pointer to the system_task_t structure of the task.
+ * @param function The task function.
+ * @param name The name of the task.
+ * @param stack Stack of the task, declared with SYSTEM_TASK_STACK(name, stack_depth).
+ * @param stack_depth Size of the stack in bytes, the same value given to SYSTEM_TASK_STACK.
+ * @param args Arguments passed to the task function through TASK_ARGS.
+ * @param priority Priority of the task.
+ * @param buffers Storage for the task control block and the stop semaphore.
+ * @param coreid Core the task is pinned to.
+ */
+void system_task_start_in_core_static(system_t *sys, system_task_t *task, TaskFunction_t function,
+                                      const char *const name, StackType_t *stack, configSTACK_DEPTH_TYPE stack_depth,
+                                      void *args, UBaseType_t priority, system_task_buffers_t *buffers,
+                                      BaseType_t coreid);
+
 // system task stop
 /**
  * The function stops a system task and deletes its handler and associated resources.
@@ -144,12 +273,108 @@ void system_task_start_in_core(system_t *sys, system_task_t *task, TaskFunction_
  */
 void system_task_stop(system_t *sys, system_task_t *task, uint16_t timeout_ms);
 
+/**
+ * The function `system_task_handle_take` gives the handle of a system task to another task that queries
+ * it (run time, name, stack), or NULL if the task has been stopped. The handle stays valid until
+ * `system_task_handle_give`, which must follow in both cases: `system_task_stop` waits for it before
+ * deleting the task. The queries in between must not block.
+ *
+ * @param task A pointer to a system task, running or stopped.
+ *
+ * @return the task handle, or NULL if the task is stopped.
+ */
+TaskHandle_t system_task_handle_take(system_task_t *task);
+void system_task_handle_give(void);
+
+/**
+ * The function `system_task_watchdog` subscribes a system task to the hardware Task Watchdog (TWDT), or
+ * unsubscribes it. A subscribed task feeds the watchdog on every TASK_LOOP iteration, so it must not
+ * block longer than SYSTEM_TASK_WDT_TIMEOUT_US between iterations. The subscription ends in TASK_END
+ * and in `system_task_stop`. It may be called from the task itself or from another task.
+ *
+ * @param task A pointer to a running system task.
+ * @param enable true to subscribe the task, false to unsubscribe it.
+ *
+ * @return ESP_OK, ESP_ERR_NOT_SUPPORTED without CONFIG_ESP_TASK_WDT_EN, or the esp_task_wdt error.
+ */
+esp_err_t system_task_watchdog(system_task_t *task, bool enable);
+
+/**
+ * The function `system_task_feed` is the TASK_LOOP condition: it feeds the Task Watchdog if the task is
+ * subscribed and tells whether the task must keep running.
+ *
+ * @param task A pointer to the calling system task.
+ *
+ * @return non-zero while the task has not been asked to stop.
+ */
+static inline UBaseType_t system_task_feed(system_task_t *task)
+{
+#if CONFIG_ESP_TASK_WDT_EN
+    if (task->sys_task_wdt) {
+        esp_task_wdt_reset();
+    }
+#endif
+    return uxSemaphoreGetCount(task->sys_task_stop);
+}
+
+/**
+ * The function `system_wait_state` waits for a state change, runs the exit hook of the previous state and
+ * the entry hook of the new one. It is the body of STATE_MACHINE and must be called from the state
+ * machine task.
+ *
+ * @param sys A pointer to the system structure.
+ * @param ticks_to_wait Maximum time to wait for a new state.
+ *
+ * @return pdTRUE if a new state is ready in sys_state, pdFALSE on timeout.
+ */
+BaseType_t system_wait_state(system_t *sys, TickType_t ticks_to_wait);
+
+/**
+ * The function `system_switch_state` requests a state change through the selected dispatch backend.
+ *
+ * @param sys A pointer to the system structure.
+ * @param st The new state.
+ */
+void system_switch_state(system_t *sys, uint8_t st);
+
+/**
+ * The function `system_delete` releases the event loop (if any) and the semaphores of a system. Its tasks
+ * must have been stopped before.
+ *
+ * @param sys A pointer to the system structure.
+ */
+void system_delete(system_t *sys);
+
+/**
+ * The function `system_rate_monotonic` assigns rate-monotonic priorities to the tasks of a table whose
+ * priority is 0: the shorter the period, the higher the priority. Tasks with the same period share a
+ * priority. The lowest one is `base_priority`; tasks with a fixed priority keep it.
+ *
+ * @param tasks Task table.
+ * @param count Number of tasks in the table.
+ * @param base_priority Priority of the task with the longest period (above the idle task: at least 1).
+ */
+void system_rate_monotonic(system_task_timing_t *tasks, size_t count, UBaseType_t base_priority);
+
+/**
+ * The function `system_schedulable` checks a task table with response-time analysis on each core (fixed
+ * priorities, preemptive; tasks with the same priority are counted as interference to each other) and
+ * logs the utilization of each core against the Liu & Layland bound and the worst-case response time
+ * of each task against its deadline. Only the tasks in the table are taken into account.
+ *
+ * @param tasks Task table, with the priorities already assigned.
+ * @param count Number of tasks in the table.
+ *
+ * @return true if every task meets its deadline.
+ */
+bool system_schedulable(const system_task_timing_t *tasks, size_t count);
+
 #define system_task_alive(sys, task) ((task)->system == (sys))
 
 // macros to develop the state machine system
 #define STATE_MACHINE(sys)                                                     \
     while (1) {                                                                \
-        if (xSemaphoreTake(sys.sys_new_state, pdMS_TO_TICKS(100)) == pdTRUE) { \
+        if (system_wait_state(&(sys), pdMS_TO_TICKS(100)) == pdTRUE) {         \
             switch (sys.sys_state)
 
 #define STATE_MACHINE_BEGIN()
@@ -167,9 +392,14 @@ void system_task_stop(system_t *sys, system_task_t *task, uint16_t timeout_ms);
 // macros to develop tasks
 #define SYSTEM_TASK(fn) void fn(void *__ptr)
 
-#define TASK_BEGIN() system_task_t *__task = (system_task_t *)__ptr
+// The task stores its own handle: a higher priority task may run before the creator
+// has written the one returned by xTaskCreateStaticPinnedToCore (same value)
+#define TASK_BEGIN()                                  \
+    system_task_t *__task = (system_task_t *)__ptr;   \
+    __task->sys_task_handler = xTaskGetCurrentTaskHandle()
 
 #define TASK_END()                         \
+    system_task_watchdog(__task, false);   \
     xSemaphoreGive(__task->sys_task_stop); \
     vTaskDelay(pdMS_TO_TICKS(50));         \
     while (1) vTaskDelay(pdMS_TO_TICKS(50))
@@ -177,11 +407,11 @@ void system_task_stop(system_t *sys, system_task_t *task, uint16_t timeout_ms);
 
 #define TASK_ARGS __task->sys_task_args
 
-#define TASK_LOOP() while (uxSemaphoreGetCount(__task->sys_task_stop))
+#define TASK_LOOP() while (system_task_feed(__task))
 
 // macros to switch state from a task
-#define SWITCH_ST_FROM_TASK(new_st) esp_event_post_to(__task->system->sys_evt_loop, (esp_event_base_t)__task->system->sys_id, new_st, NULL, 0, portMAX_DELAY)
-#define SWITCH_ST(sys, new_st) esp_event_post_to((sys)->sys_evt_loop, (esp_event_base_t)(sys)->sys_id, new_st, NULL, 0, portMAX_DELAY)
+#define SWITCH_ST_FROM_TASK(new_st) system_switch_state(__task->system, new_st)
+#define SWITCH_ST(sys, new_st) system_switch_state(sys, new_st)
 
 #define GET_ST_FROM_TASK() __task->system->sys_state
 
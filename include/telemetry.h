@@ -0,0 +1,84 @@
+#ifndef __TELEMETRY_H__
+#define __TELEMETRY_H__
+
+#include <esp_err.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "data_structures.h"
+
+// Telemetría binaria. Cada registro es
+//   tipo (u8) | contador de registros (u8) | carga | CRC-16/CCITT-FALSE (u16)
+// con el CRC calculado sobre tipo, contador y carga. El registro se codifica en COBS y
+// se termina con un 0x00, así que el receptor se resincroniza en el siguiente 0x00 tras
+// un byte perdido o corrupto, y el contador revela los registros perdidos.
+// Todos los campos son little-endian. Cargas:
+//   SAMPLE     timestamp_us u32, seq u16, flags u8, T (i16, cdeg) de cada canal de flags
+//   DEVIATION  timestamp_us u32, seq u16, flags u8, desviación u16 (1e-4), T de cada canal
+//   STATE      timestamp_us u32, estado anterior u8, estado nuevo u8
+//   STATS      telemetry_stats_t
+// Una muestra del Monitor (un canal) ocupa 13 bytes, 15 en la línea con el byte de COBS
+// y el delimitador: 150 bits con 8N1, frente a ~60 caracteres por línea del log de texto.
+// Caudal sostenido:
+//   115200 baudios:  11520 B/s ->  768 muestras/s (texto: ~190/s)
+//   921600 baudios:  92160 B/s -> 6144 muestras/s
+// más un registro DEVIATION (21 bytes en la línea con tres canales) cada CHECKER_INTERVAL_US.
+
+typedef enum {
+    TELEMETRY_SAMPLE = 1,
+    TELEMETRY_DEVIATION = 2,
+    TELEMETRY_STATE = 3,
+    TELEMETRY_STATS = 4,
+} telemetry_type_t;
+
+// Carga del registro STATS (contadores acumulados desde el arranque)
+typedef struct __attribute__((packed)) {
+    uint32_t uptime_ms;
+    uint32_t produced;     // Muestras adquiridas por Sensor
+    uint32_t consumed;     // Muestras de Sensor procesadas por Monitor
+    uint32_t queue_drops;  // Envíos rechazados, suma de todas las colas
+    uint32_t posted;       // Cambios de estado publicados por el Checker
+    uint32_t suppressed;   // Veredictos sin publicación
+    uint32_t dropped;      // Canales descartados por votación
+    uint8_t active;        // Máscara de canales en servicio
+} telemetry_stats_t;
+
+// Registro más largo (STATS, 33 bytes; DEVIATION con seis canales ocupa 25) y su tamaño codificado
+#define TELEMETRY_RECORD_MAX (2 + sizeof(telemetry_stats_t) + 2)
+#define TELEMETRY_FRAME_MAX (TELEMETRY_RECORD_MAX + TELEMETRY_RECORD_MAX / 254 + 2)
+
+// Codifica len bytes en COBS y añade el delimitador; devuelve los bytes escritos en out
+// (como mucho len + len / 254 + 2)
+size_t telemetry_cobs_encode(const uint8_t *in, size_t len, uint8_t *out);
+
+// CRC-16/CCITT-FALSE (polinomio 0x1021, valor inicial 0xFFFF)
+uint16_t telemetry_crc16(const uint8_t *data, size_t len);
+
+#if TELEMETRY_ENABLE
+
+// Configura la UART de telemetría (en linux abre TELEMETRY_LINUX_PATH)
+esp_err_t telemetry_init(void);
+
+// Envían un registro. Pueden llamarse desde varias tareas: cada registro sale en una
+// sola escritura, en orden de contador, y se bloquea si el buffer de transmisión está
+// lleno o si otra tarea está enviando
+void telemetry_sample(const sensor_data_t *data);
+void telemetry_deviation(const sensor_data_t *data);
+void telemetry_state(uint32_t timestamp_us, uint8_t from, uint8_t to);
+void telemetry_stats(const telemetry_stats_t *stats);
+
+#define TELEMETRY_SAMPLE(data) telemetry_sample(data)
+#define TELEMETRY_DEVIATION(data) telemetry_deviation(data)
+#define TELEMETRY_STATE(timestamp_us, from, to) telemetry_state((timestamp_us), (from), (to))
+#define TELEMETRY_STATS(stats) telemetry_stats(stats)
+
+#else
+
+#define TELEMETRY_SAMPLE(data) ((void)0)
+#define TELEMETRY_DEVIATION(data) ((void)0)
+#define TELEMETRY_STATE(timestamp_us, from, to) ((void)0)
+#define TELEMETRY_STATS(stats) ((void)0)
+
+#endif  // TELEMETRY_ENABLE
+
+#endif  // __TELEMETRY_H__
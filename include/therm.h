@@ -1,30 +1,66 @@
 #ifndef __THERM_H__
 #define __THERM_H__
 
-#include <esp_adc/adc_oneshot.h>
+#include <esp_err.h>
 #include <hal/adc_types.h>
+#include <sdkconfig.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if CONFIG_IDF_TARGET_LINUX
+// En el host no hay ADC ni GPIO: el termistor se simula (ver therm_sim.h) y el
+// canal y el pin sólo identifican al termistor simulado
+typedef void* adc_oneshot_unit_handle_t;
+typedef int gpio_num_t;
+#else
+#include <esp_adc/adc_continuous.h>
+#include <esp_adc/adc_oneshot.h>
 #include <soc/gpio_num.h>
+#endif
 
 // Estructura para la configuración del termistor
 typedef struct {
     adc_oneshot_unit_handle_t adc_hdlr;
     adc_channel_t adc_channel;
     gpio_num_t power_gpio;
+    uint32_t settle_us;  // Tiempo desde que se alimenta hasta que la lectura es válida
     float series_resistance;
     float nominal_resistance;
     float nominal_temperature;
     float beta_coefficient;
+    const float* lut;  // Tabla LSB -> °C (NULL si THERM_LUT_ENABLE == 0)
 } therm_t;
 
 // Funciones públicas para la configuración y uso del termistor
+// therm_init, therm_read_lsb, therm_power_on/off y therm_continuous_* acceden al
+// hardware (therm.c) o al modelo simulado en el target linux (therm_sim.c)
 esp_err_t therm_init(therm_t* thermistor, adc_channel_t channel, gpio_num_t power_gpio, float series_resistance, float nominal_resistance, float nominal_temperature, float beta_coefficient);
 float therm_read_temperature(therm_t thermistor);
 float therm_read_voltage(therm_t thermistor);
 uint16_t therm_read_lsb(therm_t thermistor);
+// Alimenta el termistor y espera settle_us (redondeado a ticks)
 void therm_power_on(therm_t thermistor);
+// Alimenta el termistor sin esperar; devuelve el instante (esp_timer, us) desde el
+// que la lectura es válida
+int64_t therm_power_on_async(therm_t thermistor);
 void therm_power_off(therm_t thermistor);
+float therm_lsb_to_temperature(therm_t thermistor, uint16_t lsb);
+
+// Modo de adquisición continua (DMA)
+// Escanea los canales de todos los termistores indicados en tramas DMA de
+// `frame_conversions` conversiones a `sample_freq_hz` (suma de todos los canales).
+// Libera la unidad oneshot: therm_read_lsb() no es válido hasta un nuevo therm_init().
+esp_err_t therm_continuous_start(const therm_t* thermistors, size_t count, uint32_t sample_freq_hz, uint32_t frame_conversions);
+// Bloquea hasta recibir una trama completa y devuelve la media LSB de cada termistor
+// (en el mismo orden que en therm_continuous_start). ESP_ERR_TIMEOUT si no llega a tiempo.
+esp_err_t therm_continuous_read(uint16_t* lsb, size_t count, uint32_t timeout_ms);
+// Descarta las tramas ya convertidas que aún no se han leído
+void therm_continuous_flush(void);
+esp_err_t therm_continuous_stop(void);
 
 // Funciones útiles de conversión
+// Rellena los parámetros del termistor y le asigna su tabla (común a ADC y simulación)
+esp_err_t _therm_configure(therm_t* thermistor, adc_channel_t channel, gpio_num_t power_gpio, float series_resistance, float nominal_resistance, float nominal_temperature, float beta_coefficient);
 float _therm_voltage_to_temperature(float voltage, float series_resistance, float nominal_resistance, float nominal_temperature, float beta_coefficient);
 float _therm_lsb_to_voltage(uint16_t lsb);
 
@@ -0,0 +1,42 @@
+#ifndef __THERM_SIM_H__
+#define __THERM_SIM_H__
+
+#include <stdint.h>
+
+#include "therm.h"
+
+// Modelo de termistor para el target linux. Sustituye al ADC y a los GPIO de
+// therm.c: cada lectura evalúa la curva de temperatura del canal en el instante
+// actual, le aplica el fallo inyectado y la convierte al código ADC que daría el
+// divisor resistivo real (más ruido). Un termistor apagado lee 0.
+// Los tiempos se cuentan desde el primer therm_init().
+
+// Curva de temperatura: base + amplitude * sin(2 pi t / period) + ramp * t
+typedef struct {
+    float base_c;
+    float amplitude_c;
+    float period_s;
+    float ramp_c_per_s;
+    uint16_t noise_lsb;  // Ruido uniforme +-noise_lsb
+} therm_sim_curve_t;
+
+// Fallos inyectables
+typedef enum {
+    THERM_SIM_FAULT_NONE,
+    THERM_SIM_FAULT_OFFSET,  // Suma value °C a la curva
+    THERM_SIM_FAULT_DRIFT,   // Suma value °C/s desde el inicio del fallo
+    THERM_SIM_FAULT_STUCK,   // Repite la última lectura anterior al fallo
+    THERM_SIM_FAULT_OPEN,    // Termistor desconectado (lee 0)
+    THERM_SIM_FAULT_SHORT,   // Termistor en cortocircuito (lee 4095)
+} therm_sim_fault_t;
+
+// Cambia la curva de un canal (por defecto THERM_SIM_* de config.h)
+void therm_sim_set_curve(adc_channel_t channel, const therm_sim_curve_t* curve);
+
+// Inyecta un fallo en un canal a partir de at_ms (THERM_SIM_FAULT_NONE lo retira)
+void therm_sim_inject_fault(adc_channel_t channel, therm_sim_fault_t fault, float value, uint32_t at_ms);
+
+// Temperatura real del canal en este instante (curva sin fallo ni ruido)
+float therm_sim_temperature(adc_channel_t channel);
+
+#endif  // __THERM_SIM_H__
@@ -0,0 +1,40 @@
+#ifndef __WINDOW_STATS_H__
+#define __WINDOW_STATS_H__
+
+#include <stdint.h>
+
+#include "config.h"
+#include "data_structures.h"
+
+// Estadísticas de las últimas WINDOW_STATS_SIZE muestras, actualizadas en O(1) por
+// muestra (amortizado):
+//   - media y varianza con Welford; al llenarse la ventana la muestra que sale se
+//     descuenta en el mismo paso en que entra la nueva
+//   - mínimo y máximo con dos colas monótonas de posiciones: cada muestra entra y sale
+//     de cada cola una sola vez
+//   - media móvil exponencial e += WINDOW_STATS_EWMA_ALPHA * (x - e), sin ventana
+// Las consume el Checker con la desviación de cada muestra (ver task_checker.c).
+
+typedef struct {
+    float values[WINDOW_STATS_SIZE];   // Últimas muestras, circular por posición
+    uint32_t pos;                      // Posición de la próxima muestra
+    uint16_t count;                    // Muestras en la ventana
+    float mean;
+    float m2;                          // Suma de cuadrados de las diferencias a la media
+    float ewma;
+    uint32_t min_q[WINDOW_STATS_SIZE]; // Posiciones con valores crecientes
+    uint32_t max_q[WINDOW_STATS_SIZE]; // Posiciones con valores decrecientes
+    uint32_t min_head, min_tail;
+    uint32_t max_head, max_tail;
+} window_stats_t;
+
+// Vacía la ventana y la media exponencial
+void window_stats_reset(window_stats_t* stats);
+
+// Añade una muestra, descontando la más antigua si la ventana está llena
+void window_stats_add(window_stats_t* stats, float x);
+
+// Resumen de la ventana (todo a 0 si está vacía)
+void window_stats_get(const window_stats_t* stats, window_summary_t* summary);
+
+#endif  // __WINDOW_STATS_H__
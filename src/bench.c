@@ -0,0 +1,512 @@
+// bench.c
+
+#include <esp_heap_caps.h>
+#include <esp_log.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/ringbuf.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if CONFIG_IDF_TARGET_LINUX
+#include <time.h>
+#else
+#include <esp_cpu.h>
+#endif
+
+#include "bench.h"
+#include "config.h"
+#include "data_structures.h"
+#include "deadline.h"
+#include "spsc_queue.h"
+#include "system.h"
+#include "therm.h"
+
+static const char *TAG = "STF_P1:bench";
+
+#if CONFIG_IDF_TARGET_LINUX
+// The host has no cycle counter: monotonic clock in nanoseconds (differences wrap like the counter)
+static inline uint32_t bench_ticks(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+#define BENCH_TICKS_UNIT "ns"
+#else
+#define bench_ticks() esp_cpu_get_cycle_count()
+#define BENCH_TICKS_UNIT "cycles"
+#endif
+
+// State transitions timed by bench_system_dispatch
+#define BENCH_TRANSITIONS 200
+
+// Items per queue run and paced items for the latency run
+#define BENCH_QUEUE_ITEMS 10000
+#define BENCH_QUEUE_PACED_ITEMS 100
+
+// Task set of bench_deadline: a periodic task as Sensor and a longer, heavier load on the same core
+// (60% utilization, schedulable under rate-monotonic priorities, not with them inverted)
+#define BENCH_DEADLINE_PERIOD_MS 100
+#define BENCH_DEADLINE_WCET_MS 30
+#define BENCH_LOAD_PERIOD_MS 400
+#define BENCH_LOAD_WCET_MS 120
+#define BENCH_DEADLINE_JOBS 20
+
+typedef struct {
+    RingbufHandle_t rb;  // Ring buffer backend (NULL if SPSC)
+    spsc_queue_t *q;     // SPSC backend (NULL if ring buffer)
+    uint32_t items;      // Items to transfer
+    bool paced;          // One item per tick instead of a burst
+    int64_t lat_sum;
+    uint32_t lat_max;
+    int64_t t_start;
+    int64_t t_end;
+    SemaphoreHandle_t done;
+} bench_queue_ctx_t;
+
+void bench_result(const char *bench, const char *variant, const char *metric, double value, const char *unit) {
+    // JSON has no nan or inf (e.g. a ratio over an empty run): the value goes as null
+    char text[32];
+    if (isfinite(value)) {
+        snprintf(text, sizeof(text), "%.3f", value);
+    } else {
+        strcpy(text, "null");
+    }
+    printf("{\"v\":%d,\"target\":\"%s\",\"t_s\":%.3f,\"bench\":\"%s\",\"case\":\"%s\",\"metric\":\"%s\","
+           "\"value\":%s,\"unit\":\"%s\"}\n",
+           BENCH_FORMAT_VERSION, CONFIG_IDF_TARGET, esp_timer_get_time() / 1e6, bench, variant, metric, text, unit);
+}
+
+void bench_run(void) {
+    ESP_LOGI(TAG, "Running benchmarks (%d iterations)", BENCH_ITERATIONS);
+    bench_therm_acquisition();
+    bench_therm_conversion();
+    bench_queue();
+    bench_system_dispatch();
+    bench_deadline();
+}
+
+void bench_therm_acquisition(void) {
+    therm_t t[2];
+    uint16_t lsb[2];
+    ESP_ERROR_CHECK(therm_init(&t[0], ADC_CHANNEL_6, THERM1_POWER_GPIO,
+                               SERIES_RESISTANCE, NOMINAL_RESISTANCE,
+                               NOMINAL_TEMPERATURE, BETA_COEFFICIENT));
+    ESP_ERROR_CHECK(therm_init(&t[1], ADC_CHANNEL_7, THERM2_POWER_GPIO,
+                               SERIES_RESISTANCE, NOMINAL_RESISTANCE,
+                               NOMINAL_TEMPERATURE, BETA_COEFFICIENT));
+
+    // Oneshot: the conversion is polled, so elapsed cycles are CPU cycles
+    uint32_t start = bench_ticks();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        lsb[i & 1] = therm_read_lsb(t[i & 1]);
+    }
+    uint32_t oneshot_cycles = (bench_ticks() - start) / BENCH_ITERATIONS;
+
+    // Continuous: let the DMA pool fill up, then time only the CPU side (read + demux)
+    ESP_ERROR_CHECK(therm_continuous_start(t, 2, THERM_CONT_SAMPLE_FREQ_HZ, THERM_CONT_FRAME_CONVERSIONS));
+    vTaskDelay(pdMS_TO_TICKS((4 * THERM_CONT_FRAME_CONVERSIONS * 1000) / THERM_CONT_SAMPLE_FREQ_HZ) + 1);
+    uint32_t frames = 0;
+    start = bench_ticks();
+    while (therm_continuous_read(lsb, 2, 0) == ESP_OK) {
+        frames++;
+    }
+    uint32_t cont_cycles = bench_ticks() - start;
+    ESP_ERROR_CHECK(therm_continuous_stop());
+
+    bench_result("therm_acquisition", "oneshot", "per_sample", oneshot_cycles, BENCH_TICKS_UNIT);
+    if (frames > 0) {
+        bench_result("therm_acquisition", "continuous", "per_sample",
+                     (double)cont_cycles / (frames * THERM_CONT_FRAME_CONVERSIONS), BENCH_TICKS_UNIT);
+    } else {
+        ESP_LOGW(TAG, "therm continuous: no frames received");
+    }
+}
+
+void bench_therm_conversion(void) {
+    therm_t t;
+    volatile float sink = 0.0f;
+    ESP_ERROR_CHECK(therm_init(&t, ADC_CHANNEL_6, THERM1_POWER_GPIO,
+                               SERIES_RESISTANCE, NOMINAL_RESISTANCE,
+                               NOMINAL_TEMPERATURE, BETA_COEFFICIENT));
+
+    // Each step of the formula on its own: LSB -> voltage, then voltage -> °C (resistance and log())
+    volatile float voltage = 0.0f;
+    uint32_t start = bench_ticks();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        voltage = _therm_lsb_to_voltage((i * 7 + 100) & 0x0FFF);
+    }
+    uint32_t voltage_cycles = (bench_ticks() - start) / BENCH_ITERATIONS;
+
+    start = bench_ticks();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        sink = _therm_voltage_to_temperature(0.5f + (i & 0xFF) * 0.008f, t.series_resistance, t.nominal_resistance,
+                                             t.nominal_temperature, t.beta_coefficient);
+    }
+    uint32_t temperature_cycles = (bench_ticks() - start) / BENCH_ITERATIONS;
+
+    // Formula: voltage, resistance and log() on every call
+    start = bench_ticks();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        uint16_t lsb = (i * 7 + 100) & 0x0FFF;
+        sink = _therm_voltage_to_temperature(_therm_lsb_to_voltage(lsb), t.series_resistance, t.nominal_resistance,
+                                             t.nominal_temperature, t.beta_coefficient);
+    }
+    uint32_t formula_cycles = (bench_ticks() - start) / BENCH_ITERATIONS;
+
+    // Table built in therm_init
+    start = bench_ticks();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        uint16_t lsb = (i * 7 + 100) & 0x0FFF;
+        sink = therm_lsb_to_temperature(t, lsb);
+    }
+    uint32_t table_cycles = (bench_ticks() - start) / BENCH_ITERATIONS;
+    (void)sink;
+    (void)voltage;
+
+    // Worst error of the table against the formula in the -40..125°C range
+    float max_error = 0.0f;
+    for (uint16_t lsb = 1; lsb < 4095; lsb++) {
+        float ref = _therm_voltage_to_temperature(_therm_lsb_to_voltage(lsb), t.series_resistance, t.nominal_resistance,
+                                                  t.nominal_temperature, t.beta_coefficient);
+        if (ref >= -40.0f && ref <= 125.0f) {
+            float error = fabsf(therm_lsb_to_temperature(t, lsb) - ref);
+            if (error > max_error) max_error = error;
+        }
+    }
+
+    bench_result("therm_conversion", "lsb_to_voltage", "per_call", voltage_cycles, BENCH_TICKS_UNIT);
+    bench_result("therm_conversion", "voltage_to_temperature", "per_call", temperature_cycles, BENCH_TICKS_UNIT);
+    bench_result("therm_conversion", "formula", "per_call", formula_cycles, BENCH_TICKS_UNIT);
+    bench_result("therm_conversion", "table", "per_call", table_cycles, BENCH_TICKS_UNIT);
+    bench_result("therm_conversion", "table", "max_error", max_error, "degC");
+}
+
+static void bench_queue_producer(void *arg) {
+    bench_queue_ctx_t *ctx = (bench_queue_ctx_t *)arg;
+    sensor_data_t item = {.version = SENSOR_DATA_VERSION, .flags = DATA_SOURCE_SENSOR};
+
+    ctx->t_start = esp_timer_get_time();
+    for (uint32_t n = 0; n < ctx->items; n++) {
+        if (ctx->paced) {
+            vTaskDelay(1);
+        }
+        item.seq = n;
+        item.timestamp_us = (uint32_t)esp_timer_get_time();
+        if (ctx->rb != NULL) {
+            xRingbufferSend(ctx->rb, &item, sizeof(item), portMAX_DELAY);
+        } else {
+            while (!spsc_queue_send(ctx->q, &item)) {
+                taskYIELD();
+            }
+        }
+    }
+    vTaskDelete(NULL);
+}
+
+static void bench_queue_consumer(void *arg) {
+    bench_queue_ctx_t *ctx = (bench_queue_ctx_t *)arg;
+    sensor_data_t item;
+    size_t item_size;
+
+    for (uint32_t n = 0; n < ctx->items; n++) {
+        if (ctx->rb != NULL) {
+            sensor_data_t *p = (sensor_data_t *)xRingbufferReceive(ctx->rb, &item_size, portMAX_DELAY);
+            item = *p;
+            vRingbufferReturnItem(ctx->rb, p);
+        } else {
+            spsc_queue_receive(ctx->q, &item, portMAX_DELAY);
+        }
+        uint32_t latency = (uint32_t)esp_timer_get_time() - item.timestamp_us;
+        ctx->lat_sum += latency;
+        if (latency > ctx->lat_max) ctx->lat_max = latency;
+    }
+    ctx->t_end = esp_timer_get_time();
+    xSemaphoreGive(ctx->done);
+    vTaskDelete(NULL);
+}
+
+// Producer on CORE0 and consumer on CORE1, as Sensor and Monitor
+static void bench_queue_run(const char *name, RingbufHandle_t rb, spsc_queue_t *q, bool paced) {
+    bench_queue_ctx_t ctx = {
+        .rb = rb,
+        .q = q,
+        .items = paced ? BENCH_QUEUE_PACED_ITEMS : BENCH_QUEUE_ITEMS,
+        .paced = paced,
+        .done = xSemaphoreCreateBinary(),
+    };
+    xTaskCreatePinnedToCore(bench_queue_consumer, "bench_cons", 2048, &ctx, 1, NULL, CORE1);
+    xTaskCreatePinnedToCore(bench_queue_producer, "bench_prod", 2048, &ctx, 1, NULL, CORE0);
+    xSemaphoreTake(ctx.done, portMAX_DELAY);
+    vSemaphoreDelete(ctx.done);
+
+    int64_t elapsed = ctx.t_end - ctx.t_start;
+    if (!paced) {
+        // A paced run is bound by the tick, not by the queue
+        bench_result("queue", name, "throughput", (double)ctx.items * 1e6 / (elapsed > 0 ? elapsed : 1), "items/s");
+    }
+    bench_result("queue", name, "latency_mean", (double)ctx.lat_sum / ctx.items, "us");
+    bench_result("queue", name, "latency_max", ctx.lat_max, "us");
+}
+
+void bench_queue(void) {
+    RingbufHandle_t rb = xRingbufferCreate(BUFFER_SIZE, BUFFER_TYPE);
+    spsc_queue_t q;
+    ESP_ERROR_CHECK(spsc_queue_create(&q, sizeof(sensor_data_t), QUEUE_LENGTH));
+
+    bench_queue_run("ringbuf", rb, NULL, false);
+    bench_queue_run("spsc", NULL, &q, false);
+    bench_queue_run("ringbuf_paced", rb, NULL, true);
+    bench_queue_run("spsc_paced", NULL, &q, true);
+
+    vRingbufferDelete(rb);
+    spsc_queue_delete(&q);
+}
+
+static int bench_compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+typedef struct {
+    system_t *sys;
+    volatile int64_t t_switch;  // Time of the last SWITCH_ST
+    SemaphoreHandle_t ack;      // Given by the state machine once the state is entered
+} bench_dispatch_ctx_t;
+
+// Requests alternating states from another task, as Checker does
+static void bench_dispatch_switcher(void *arg) {
+    bench_dispatch_ctx_t *ctx = (bench_dispatch_ctx_t *)arg;
+    for (int i = 0; i < BENCH_TRANSITIONS; i++) {
+        ctx->t_switch = esp_timer_get_time();
+        SWITCH_ST(ctx->sys, (i & 1) ? 1 : 2);
+        xSemaphoreTake(ctx->ack, portMAX_DELAY);
+    }
+    vTaskDelete(NULL);
+}
+
+void bench_system_dispatch(void) {
+    system_t sys;
+    bench_dispatch_ctx_t ctx = {.sys = &sys, .ack = xSemaphoreCreateBinary()};
+    static uint32_t latency[BENCH_TRANSITIONS];
+    int64_t lat_sum = 0;
+
+    // RAM taken by the backend (event loop task, queue and handlers, or nothing)
+    size_t heap_before = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    system_create(&sys, "bench_sys");
+    system_register_state(&sys, 0);
+    system_register_state(&sys, 1);
+    system_register_state(&sys, 2);
+    size_t heap_used = heap_before - heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    system_set_default_state(&sys, 0);
+    system_wait_state(&sys, portMAX_DELAY);
+
+    // This task owns the state machine; the switcher runs on the other core
+    xTaskCreatePinnedToCore(bench_dispatch_switcher, "bench_switch", 2048, &ctx, uxTaskPriorityGet(NULL), NULL, CORE1);
+    for (int i = 0; i < BENCH_TRANSITIONS; i++) {
+        while (system_wait_state(&sys, portMAX_DELAY) != pdTRUE) {
+        }
+        latency[i] = esp_timer_get_time() - ctx.t_switch;
+        lat_sum += latency[i];
+        xSemaphoreGive(ctx.ack);
+    }
+
+    system_delete(&sys);
+    vSemaphoreDelete(ctx.ack);
+
+    // Percentiles of the transition latency
+    qsort(latency, BENCH_TRANSITIONS, sizeof(latency[0]), bench_compare_u32);
+    const char *backend = SYSTEM_DISPATCH == SYSTEM_DISPATCH_NOTIFY ? "notify" : "esp_event";
+    bench_result("system_dispatch", backend, "transition_mean", (double)lat_sum / BENCH_TRANSITIONS, "us");
+    bench_result("system_dispatch", backend, "transition_p50", latency[BENCH_TRANSITIONS / 2], "us");
+    bench_result("system_dispatch", backend, "transition_p99", latency[BENCH_TRANSITIONS * 99 / 100], "us");
+    bench_result("system_dispatch", backend, "transition_max", latency[BENCH_TRANSITIONS - 1], "us");
+    bench_result("system_dispatch", backend, "heap", heap_used, "bytes");
+    bench_result("system_dispatch", backend, "system_t", sizeof(system_t), "bytes");
+}
+
+typedef struct {
+    uint32_t loops_per_ms;   // Busy loop calibration
+    TickType_t start_tick;   // Common first release (critical instant)
+    int64_t tick_offset_us;  // esp_timer time of tick 0
+    volatile bool stop;      // Ends the load task
+    uint32_t misses;         // Periodic task: jobs finished after their deadline
+    int64_t resp_sum;
+    int64_t resp_max;
+    SemaphoreHandle_t done;  // Given by each task when it exits
+} bench_deadline_ctx_t;
+
+static void bench_spin(uint32_t loops) {
+    for (volatile uint32_t i = 0; i < loops; i++) {
+    }
+}
+
+// Periodic task: response time of each job from its nominal release
+static void bench_deadline_periodic(void *arg) {
+    bench_deadline_ctx_t *ctx = (bench_deadline_ctx_t *)arg;
+    const TickType_t period = pdMS_TO_TICKS(BENCH_DEADLINE_PERIOD_MS);
+    TickType_t wake = ctx->start_tick - period;
+
+    for (int k = 0; k < BENCH_DEADLINE_JOBS; k++) {
+        vTaskDelayUntil(&wake, period);
+        int64_t release = ctx->tick_offset_us + (int64_t)wake * portTICK_PERIOD_MS * 1000;
+        bench_spin(ctx->loops_per_ms * BENCH_DEADLINE_WCET_MS);
+        int64_t response = esp_timer_get_time() - release;
+        ctx->resp_sum += response;
+        if (response > ctx->resp_max) ctx->resp_max = response;
+        if (response > BENCH_DEADLINE_PERIOD_MS * 1000) ctx->misses++;
+    }
+    ctx->stop = true;
+    xSemaphoreGive(ctx->done);
+    vTaskDelete(NULL);
+}
+
+// Load task: a burst of CPU every period until the periodic task ends
+static void bench_deadline_load(void *arg) {
+    bench_deadline_ctx_t *ctx = (bench_deadline_ctx_t *)arg;
+    const TickType_t period = pdMS_TO_TICKS(BENCH_LOAD_PERIOD_MS);
+    TickType_t wake = ctx->start_tick - period;
+
+    while (!ctx->stop) {
+        vTaskDelayUntil(&wake, period);
+        bench_spin(ctx->loops_per_ms * BENCH_LOAD_WCET_MS);
+    }
+    xSemaphoreGive(ctx->done);
+    vTaskDelete(NULL);
+}
+
+// One run on a core; load_priority 0 runs the periodic task alone
+static void bench_deadline_run(const char *name, BaseType_t core, uint32_t loops_per_ms, UBaseType_t periodic_priority,
+                               UBaseType_t load_priority) {
+    bench_deadline_ctx_t ctx = {.loops_per_ms = loops_per_ms, .done = xSemaphoreCreateCounting(2, 0)};
+
+    // Analysis of the same task set
+    system_task_timing_t timing[] = {
+        {"periodic", BENCH_DEADLINE_PERIOD_MS * 1000, BENCH_DEADLINE_PERIOD_MS * 1000, BENCH_DEADLINE_WCET_MS * 1000,
+         periodic_priority, core, 2048},
+        {"load", BENCH_LOAD_PERIOD_MS * 1000, BENCH_LOAD_PERIOD_MS * 1000, BENCH_LOAD_WCET_MS * 1000, load_priority,
+         core, 2048},
+    };
+    bool schedulable = system_schedulable(timing, load_priority ? 2 : 1);
+
+    // Both tasks are first released on the same tick, a few ticks ahead
+    vTaskDelay(1);
+    ctx.tick_offset_us = esp_timer_get_time() - (int64_t)xTaskGetTickCount() * portTICK_PERIOD_MS * 1000;
+    ctx.start_tick = xTaskGetTickCount() + 2;
+    xTaskCreatePinnedToCore(bench_deadline_periodic, "bench_period", 2048, &ctx, periodic_priority, NULL, core);
+    if (load_priority) {
+        xTaskCreatePinnedToCore(bench_deadline_load, "bench_load", 2048, &ctx, load_priority, NULL, core);
+    }
+    for (int n = load_priority ? 2 : 1; n > 0; n--) {
+        xSemaphoreTake(ctx.done, portMAX_DELAY);
+    }
+    vSemaphoreDelete(ctx.done);
+
+    char variant[32];
+    snprintf(variant, sizeof(variant), "core%d_%s", (int)core, name);
+    bench_result("deadline", variant, "late_jobs", ctx.misses, "jobs");
+    bench_result("deadline", variant, "response_mean", (double)ctx.resp_sum / BENCH_DEADLINE_JOBS, "us");
+    bench_result("deadline", variant, "response_max", ctx.resp_max, "us");
+    bench_result("deadline", variant, "schedulable", schedulable, "bool");
+}
+
+void bench_deadline(void) {
+    // Busy loop iterations per millisecond, calibrated without load
+    const uint32_t calibration = 1000000;
+    int64_t t0 = esp_timer_get_time();
+    bench_spin(calibration);
+    int64_t elapsed = esp_timer_get_time() - t0;
+    uint32_t loops_per_ms = (uint64_t)calibration * 1000 / (elapsed > 0 ? elapsed : 1);
+
+    // Above this task, so it only waits for the results
+    UBaseType_t low = uxTaskPriorityGet(NULL) + 1;
+    for (BaseType_t core = 0; core < portNUM_PROCESSORS; core++) {
+        bench_deadline_run("alone", core, loops_per_ms, low + 1, 0);
+        bench_deadline_run("rate_monotonic", core, loops_per_ms, low + 1, low);
+        bench_deadline_run("inverted", core, loops_per_ms, low, low + 1);
+    }
+}
+
+// Soak: the running pipeline, reported every BENCH_SOAK_REPORT_S until BENCH_SOAK_S
+static void bench_soak_task(void *arg) {
+    const task_stats_args_t *p = (const task_stats_args_t *)arg;
+    const TickType_t period = pdMS_TO_TICKS(BENCH_SOAK_REPORT_S * 1000);
+    TickType_t wake = xTaskGetTickCount();
+    int64_t start = esp_timer_get_time();
+    int64_t last = start;
+    uint32_t last_produced = p->counters->produced;
+    uint32_t last_consumed = p->counters->consumed;
+
+    ESP_LOGI(TAG, "Soak of the pipeline for %d s", BENCH_SOAK_S);
+    for (int64_t elapsed = 0; elapsed < BENCH_SOAK_S * 1000000LL;) {
+        vTaskDelayUntil(&wake, period);
+        int64_t now = esp_timer_get_time();
+        int64_t interval = now - last;
+        elapsed = now - start;
+        last = now;
+
+        // Throughput and backlog
+        uint32_t produced = p->counters->produced;
+        uint32_t consumed = p->counters->consumed;
+        bench_result("soak", "pipeline", "elapsed", elapsed / 1e6, "s");
+        bench_result("soak", "pipeline", "produced", produced, "samples");
+        bench_result("soak", "pipeline", "consumed", consumed, "samples");
+        bench_result("soak", "pipeline", "backlog", (int32_t)(produced - consumed), "samples");
+        bench_result("soak", "pipeline", "produced_rate", (double)(produced - last_produced) * 1e6 / interval,
+                     "samples/s");
+        bench_result("soak", "pipeline", "consumed_rate", (double)(consumed - last_consumed) * 1e6 / interval,
+                     "samples/s");
+        last_produced = produced;
+        last_consumed = consumed;
+
+        // Losses and transitions since boot
+        for (size_t q = 0; q < p->nqueues; q++) {
+            bench_result("soak", p->queue_names[q], "drops", p->queues[q]->drops, "items");
+        }
+        if (p->checker != NULL) {
+            bench_result("soak", "checker", "posted", p->checker->posted, "transitions");
+            bench_result("soak", "checker", "dropped", p->checker->dropped, "channels");
+        }
+        for (size_t d = 0; d < deadline_count(); d++) {
+            const deadline_monitor_t *dm = deadline_get(d);
+            bench_result("soak", dm->name, "late", dm->late, "periods");
+            bench_result("soak", dm->name, "missed", dm->missed, "periods");
+            bench_result("soak", dm->name, "worst_overrun", dm->worst_overrun_us, "us");
+        }
+
+        // Memory: a leak or a stack close to overflow shows up as a trend
+        for (size_t t = 0; t < p->ntasks; t++) {
+            char name[configMAX_TASK_NAME_LEN];
+            UBaseType_t stack_free = 0;
+            TaskHandle_t handle = system_task_handle_take(p->tasks[t]);
+            if (handle != NULL) {
+                snprintf(name, sizeof(name), "%s", pcTaskGetName(handle));
+                stack_free = uxTaskGetStackHighWaterMark(handle);
+            }
+            system_task_handle_give();
+            // Stopped tasks (ERROR) are skipped
+            if (handle != NULL) {
+                bench_result("soak", name, "stack_free", stack_free, "bytes");
+            }
+        }
+        bench_result("soak", "system", "heap_free", esp_get_free_heap_size(), "bytes");
+    }
+
+    ESP_LOGI(TAG, "Soak finished");
+#if CONFIG_IDF_TARGET_LINUX
+    // Host run: the process ends with the soak, so it can be scripted
+    fflush(stdout);
+    exit(0);
+#endif
+    vTaskDelete(NULL);
+}
+
+void bench_soak_start(const task_stats_args_t *pipeline) {
+    xTaskCreatePinnedToCore(bench_soak_task, "bench_soak", 3072, (void *)pipeline, TASK_PRIORITY_BASE, NULL, CORE1);
+}
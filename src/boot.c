@@ -0,0 +1,64 @@
+// boot.c
+
+#include "boot.h"
+
+#include <esp_log.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <stdatomic.h>
+
+static const char *TAG = "STF_P1:boot";
+
+static const char *const boot_phase_names[BOOT_PHASE_COUNT] = {
+    "app_main", "NVS ready", "tasks started", "tasks ready", "first sample", "first verdict",
+};
+
+static StaticEventGroup_t boot_group_buffer;
+static EventGroupHandle_t boot_group = NULL;
+
+// Instante de cada fase en us desde el arranque, 0 mientras no ha ocurrido
+static _Atomic uint32_t boot_phase_us[BOOT_PHASE_COUNT];
+static atomic_bool boot_reported = false;
+
+void boot_init(void) {
+    boot_group = xEventGroupCreateStatic(&boot_group_buffer);
+}
+
+void boot_ready(EventBits_t bit) {
+    xEventGroupSetBits(boot_group, bit);
+}
+
+bool boot_wait_ready(EventBits_t bits, TickType_t ticks_to_wait) {
+    EventBits_t ready = xEventGroupWaitBits(boot_group, bits, pdFALSE, pdTRUE, ticks_to_wait);
+    if ((ready & bits) != bits) {
+        ESP_LOGW(TAG, "Tasks 0x%02lx not ready", (unsigned long)(bits & ~ready));
+        return false;
+    }
+    boot_mark(BOOT_PHASE_TASKS_READY);
+    return true;
+}
+
+void boot_mark(boot_phase_t phase) {
+    // Nunca 0: el 0 indica fase pendiente
+    uint32_t now = (uint32_t)esp_timer_get_time() | 1;
+    uint32_t expected = 0;
+    atomic_compare_exchange_strong(&boot_phase_us[phase], &expected, now);
+}
+
+void boot_report(void) {
+    if (atomic_exchange(&boot_reported, true)) {
+        return;
+    }
+
+    ESP_LOGI(TAG, "Boot phases (reset reason %d):", esp_reset_reason());
+    uint32_t prev = 0;
+    for (int p = 0; p < BOOT_PHASE_COUNT; p++) {
+        uint32_t t = atomic_load(&boot_phase_us[p]);
+        if (t == 0) {
+            ESP_LOGI(TAG, "  %-14s -", boot_phase_names[p]);
+            continue;
+        }
+        ESP_LOGI(TAG, "  %-14s %8lu us (+%lu us)", boot_phase_names[p], (unsigned long)t, (unsigned long)(t - prev));
+        prev = t;
+    }
+}
@@ -0,0 +1,149 @@
+// command.c
+
+#include "command.h"
+
+#if COMMAND_ENABLE
+
+#include <esp_log.h>
+#include <fcntl.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if CONFIG_IDF_TARGET_LINUX
+#include <poll.h>
+#endif
+
+#include "sensor_rate.h"
+
+static const char *TAG = "STF_P1:command";
+
+static void command_rate(sensor_rate_t *rate, const char *arg) {
+    if (*arg == '\0') {
+        printf("rate: %lu us\n", (unsigned long)atomic_load(&rate->period_us));
+        return;
+    }
+
+    char *end;
+    unsigned long long period_us = strtoull(arg, &end, 10);
+    if (*arg == '-' || end == arg || *end != '\0') {
+        printf("rate: '%s' is not a period in us\n", arg);
+        return;
+    }
+    esp_err_t ret = period_us <= UINT32_MAX ? sensor_rate_set(rate, (uint32_t)period_us) : ESP_ERR_INVALID_ARG;
+    if (ret == ESP_ERR_INVALID_ARG) {
+        printf("rate: %llu us out of range [%lu, %lu]\n", period_us, (unsigned long)SENSOR_PERIOD_MIN_US,
+               (unsigned long)SENSOR_PERIOD_MAX_US);
+    } else if (ret != ESP_OK) {
+        // El periodo ya está en vigor, pero no se ha podido guardar
+        printf("rate: %llu us, not stored: %s\n", period_us, esp_err_to_name(ret));
+    } else {
+        printf("rate: %llu us\n", period_us);
+    }
+}
+
+// Ejecuta una línea: orden y argumento separados por espacios
+static void command_run(sensor_rate_t *rate, char *line) {
+    char *cmd = line + strspn(line, " \t");
+    char *arg = cmd + strcspn(cmd, " \t");
+    if (*arg != '\0') {
+        *arg++ = '\0';
+        arg += strspn(arg, " \t");
+        arg[strcspn(arg, " \t")] = '\0';
+    }
+
+    if (*cmd == '\0') {
+        return;
+    }
+    if (strcmp(cmd, "rate") == 0) {
+        command_rate(rate, arg);
+    } else if (strcmp(cmd, "help") == 0) {
+        printf("rate               sample period in force\n"
+               "rate <period_us>   change the sample period and store it\n");
+    } else {
+        printf("%s: unknown command (help)\n", cmd);
+    }
+}
+
+// Lee un carácter de la entrada si hay alguno, sin bloquear
+static bool command_getc(char *c) {
+#if CONFIG_IDF_TARGET_LINUX
+    // En el host stdin suele compartir el terminal con stdout: O_NONBLOCK afectaría
+    // también a las escrituras, así que se consulta antes de leer
+    struct pollfd pfd = {.fd = STDIN_FILENO, .events = POLLIN};
+    if (poll(&pfd, 1, 0) != 1 || !(pfd.revents & POLLIN)) {
+        return false;
+    }
+#endif
+    return read(STDIN_FILENO, c, 1) == 1;
+}
+
+// Tarea de órdenes: la entrada se lee sin bloquear, así que la tarea sólo ocupa la
+// CPU en cada sondeo (en el host una lectura bloqueante pararía el port POSIX)
+static void command_task(void *arg) {
+    sensor_rate_t *rate = (sensor_rate_t *)arg;
+    char line[COMMAND_LINE_SIZE];
+    size_t len = 0;
+    bool overflow = false;
+
+    for (;;) {
+        char c;
+        while (command_getc(&c)) {
+            if (c != '\n' && c != '\r') {
+                if (len < sizeof(line) - 1) {
+                    line[len++] = c;
+                } else {
+                    overflow = true;
+                }
+                continue;
+            }
+            line[len] = '\0';
+            if (overflow) {
+                printf("command longer than %d characters ignored\n", COMMAND_LINE_SIZE - 1);
+            } else {
+                command_run(rate, line);
+            }
+            fflush(stdout);
+            len = 0;
+            overflow = false;
+        }
+        vTaskDelay(pdMS_TO_TICKS(COMMAND_POLL_MS));
+    }
+}
+
+#if STATIC_ALLOCATION
+// Tarea de órdenes fuera del heap, como el resto del pipeline (ver STATIC_ALLOCATION)
+static StackType_t command_stack[COMMAND_TASK_STACK_SIZE / sizeof(StackType_t)];
+static StaticTask_t command_tcb;
+#endif
+
+esp_err_t command_init(sensor_rate_t *rate, UBaseType_t priority, BaseType_t core) {
+#if !CONFIG_IDF_TARGET_LINUX
+    // Consola en la UART del log: sin driver la lectura ya no bloquea, con driver sí
+    int flags = fcntl(STDIN_FILENO, F_GETFL, 0);
+    if (flags < 0 || fcntl(STDIN_FILENO, F_SETFL, flags | O_NONBLOCK) < 0) {
+        ESP_LOGW(TAG, "Console input not available, commands disabled");
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+#endif
+
+#if STATIC_ALLOCATION
+    if (xTaskCreateStaticPinnedToCore(command_task, "command", COMMAND_TASK_STACK_SIZE, rate, priority, command_stack,
+                                      &command_tcb, core) == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+#else
+    if (xTaskCreatePinnedToCore(command_task, "command", COMMAND_TASK_STACK_SIZE, rate, priority, NULL, core) !=
+        pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+#endif
+    ESP_LOGI(TAG, "Console commands ready (help)");
+    return ESP_OK;
+}
+
+#endif  // COMMAND_ENABLE
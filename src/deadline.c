@@ -0,0 +1,89 @@
+// deadline.c
+
+#include "deadline.h"
+
+#include <esp_log.h>
+#include <stdatomic.h>
+
+static const char *TAG = "STF_P1:deadline";
+
+// Registro para los informes: el puntero se publica antes que la cuenta
+static deadline_monitor_t *deadline_monitors[DEADLINE_MAX_MONITORS];
+static _Atomic size_t deadline_registered = 0;
+
+void deadline_init(deadline_monitor_t *dm, const char *name, uint32_t deadline_us) {
+    dm->name = name;
+    dm->deadline_us = deadline_us;
+    dm->activations = 0;
+    dm->late = 0;
+    dm->missed = 0;
+    dm->worst_overrun_us = 0;
+    dm->consecutive = 0;
+    dm->stage = DEADLINE_OK;
+
+    size_t count = atomic_load_explicit(&deadline_registered, memory_order_acquire);
+    for (size_t i = 0; i < count; i++) {
+        if (deadline_monitors[i] == dm) {
+            return;
+        }
+    }
+    if (count == DEADLINE_MAX_MONITORS) {
+        ESP_LOGW(TAG, "%s not registered (DEADLINE_MAX_MONITORS)", name);
+        return;
+    }
+    deadline_monitors[count] = dm;
+    atomic_store_explicit(&deadline_registered, count + 1, memory_order_release);
+}
+
+void deadline_set(deadline_monitor_t *dm, uint32_t deadline_us) {
+    dm->deadline_us = deadline_us;
+}
+
+// Un periodo más en la racha: devuelve la etapa si es nueva en esta racha
+static deadline_stage_t deadline_escalate(deadline_monitor_t *dm) {
+    dm->consecutive++;
+
+    deadline_stage_t stage = DEADLINE_OK;
+    if (DEADLINE_RESTART_AFTER > 0 && dm->consecutive >= DEADLINE_RESTART_AFTER) {
+        stage = DEADLINE_RESTART;
+    } else if (DEADLINE_DEGRADE_AFTER > 0 && dm->consecutive >= DEADLINE_DEGRADE_AFTER) {
+        stage = DEADLINE_DEGRADE;
+    } else if (DEADLINE_LOG_AFTER > 0 && dm->consecutive >= DEADLINE_LOG_AFTER) {
+        stage = DEADLINE_LOG;
+    }
+
+    if (stage <= dm->stage) {
+        return DEADLINE_OK;
+    }
+    dm->stage = stage;
+    return stage;
+}
+
+deadline_stage_t deadline_complete(deadline_monitor_t *dm, uint32_t response_us) {
+    dm->activations++;
+    if (response_us <= dm->deadline_us) {
+        dm->consecutive = 0;
+        dm->stage = DEADLINE_OK;
+        return DEADLINE_OK;
+    }
+
+    uint32_t overrun_us = response_us - dm->deadline_us;
+    dm->late++;
+    if (overrun_us > dm->worst_overrun_us) {
+        dm->worst_overrun_us = overrun_us;
+    }
+    return deadline_escalate(dm);
+}
+
+deadline_stage_t deadline_miss(deadline_monitor_t *dm) {
+    dm->missed++;
+    return deadline_escalate(dm);
+}
+
+size_t deadline_count(void) {
+    return atomic_load_explicit(&deadline_registered, memory_order_acquire);
+}
+
+const deadline_monitor_t *deadline_get(size_t index) {
+    return index < deadline_count() ? deadline_monitors[index] : NULL;
+}
@@ -0,0 +1,267 @@
+// dlog.c
+
+#include "dlog.h"
+
+#if DLOG_ENABLE
+
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <stdatomic.h>
+#include <stdio.h>
+
+static const char *TAG = "STF_P1:dlog";
+
+#if CONFIG_IDF_TARGET_LINUX || CONFIG_FREERTOS_UNICORE
+#define DLOG_CORES 1
+#else
+#define DLOG_CORES portNUM_PROCESSORS
+#endif
+
+_Static_assert((DLOG_ENTRIES & (DLOG_ENTRIES - 1)) == 0, "DLOG_ENTRIES must be a power of 2");
+
+// La vuelta de cada entrada se guarda relativa a su índice (pos & ~mask), de modo que
+// el buffer a cero ya está listo para escribir sin inicializarlo
+#define DLOG_LAP(pos) ((pos) & ~(uint32_t)(DLOG_ENTRIES - 1))
+
+typedef struct {
+    _Atomic uint32_t seq;  // DLOG_LAP(pos): libre para pos; DLOG_LAP(pos) + 1: publicada
+    uint8_t level;
+    uint8_t nargs;
+    const char *tag;
+    const char *fmt;
+    int64_t time_us;
+    uint64_t args[DLOG_MAX_ARGS];
+} dlog_entry_t;
+
+// Buffer de un núcleo: cola acotada de varios productores (las tareas del núcleo, con
+// CAS sobre head) y un consumidor (la tarea de vaciado). Cada entrada lleva su número
+// de secuencia, que indica si está libre o publicada para la vuelta actual
+typedef struct {
+    _Atomic uint32_t head;     // Próxima posición a reservar
+    uint32_t tail;             // Próxima posición a leer (sólo la tarea de vaciado)
+    _Atomic uint32_t dropped;  // Entradas descartadas por buffer lleno
+    dlog_entry_t entries[DLOG_ENTRIES];
+} dlog_ring_t;
+
+static dlog_ring_t dlog_rings[DLOG_CORES];
+
+static const char dlog_letters[] = {'N', 'E', 'W', 'I', 'D', 'V'};
+
+void dlog_write(esp_log_level_t level, const char *tag, const char *fmt, const uint64_t *args, uint8_t nargs) {
+    int64_t now = esp_timer_get_time();
+#if DLOG_CORES > 1
+    dlog_ring_t *ring = &dlog_rings[xPortGetCoreID()];
+#else
+    dlog_ring_t *ring = &dlog_rings[0];
+#endif
+
+    // Reserva una entrada. Si la tarea cambia de núcleo o es desalojada a mitad, el CAS
+    // sigue siendo correcto: sólo se pierde la localidad
+    dlog_entry_t *entry;
+    uint32_t pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    for (;;) {
+        entry = &ring->entries[pos & (DLOG_ENTRIES - 1)];
+        int32_t diff = (int32_t)(atomic_load_explicit(&entry->seq, memory_order_acquire) - DLOG_LAP(pos));
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&ring->head, &pos, pos + 1, memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // La entrada de hace una vuelta aún no se ha vaciado: buffer lleno
+            atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+            return;
+        } else {
+            pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        }
+    }
+
+    entry->level = level;
+    entry->nargs = nargs;
+    entry->tag = tag;
+    entry->fmt = fmt;
+    entry->time_us = now;
+    memcpy(entry->args, args, nargs * sizeof(uint64_t));
+    atomic_store_explicit(&entry->seq, DLOG_LAP(pos) + 1, memory_order_release);
+}
+
+uint32_t dlog_dropped(void) {
+    uint32_t dropped = 0;
+    for (int c = 0; c < DLOG_CORES; c++) {
+        dropped += atomic_load_explicit(&dlog_rings[c].dropped, memory_order_relaxed);
+    }
+    return dropped;
+}
+
+// Formatea una conversión del formato con el argumento guardado. Los enteros se
+// imprimen siempre con "ll" tras ajustar el valor al tamaño que indicaba el formato
+static int dlog_format_one(char *out, size_t size, const char *spec, size_t spec_len, char conv, int length,
+                           uint64_t arg) {
+    char f[24];
+    if (spec_len > sizeof(f) - 4) {
+        spec_len = sizeof(f) - 4;
+    }
+    memcpy(f, spec, spec_len);
+    size_t n = spec_len;
+
+    switch (conv) {
+        case 'd':
+        case 'i':
+            f[n++] = 'l';
+            f[n++] = 'l';
+            f[n++] = conv;
+            f[n] = '\0';
+            return snprintf(out, size, f, length == 64 ? (long long)arg : (long long)(int32_t)arg);
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+            f[n++] = 'l';
+            f[n++] = 'l';
+            f[n++] = conv;
+            f[n] = '\0';
+            return snprintf(out, size, f, length == 64 ? (unsigned long long)arg : (unsigned long long)(uint32_t)arg);
+        case 'c':
+            f[n++] = conv;
+            f[n] = '\0';
+            return snprintf(out, size, f, (int)arg);
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A': {
+            double value;
+            memcpy(&value, &arg, sizeof(value));
+            f[n++] = conv;
+            f[n] = '\0';
+            return snprintf(out, size, f, value);
+        }
+        case 's':
+            f[n++] = conv;
+            f[n] = '\0';
+            return snprintf(out, size, f, arg ? (const char *)(uintptr_t)arg : "(null)");
+        case 'p':
+            f[n++] = conv;
+            f[n] = '\0';
+            return snprintf(out, size, f, (void *)(uintptr_t)arg);
+        default:
+            return 0;
+    }
+}
+
+// Formatea una entrada completa en out (truncada a size)
+static void dlog_format(char *out, size_t size, const dlog_entry_t *entry) {
+    size_t len = 0;
+    uint8_t a = 0;
+    const char *p = entry->fmt;
+
+    while (*p != '\0' && len < size - 1) {
+        if (*p != '%') {
+            out[len++] = *p++;
+            continue;
+        }
+        if (p[1] == '%') {
+            out[len++] = '%';
+            p += 2;
+            continue;
+        }
+
+        // %[flags][anchura][.precisión][longitud]conversión
+        const char *spec = p++;
+        p += strspn(p, "-+ #0123456789.");
+        size_t spec_len = p - spec;
+        int length = 32;
+        while (*p == 'h' || *p == 'l' || *p == 'L' || *p == 'z' || *p == 'j' || *p == 't' || *p == 'q') {
+            if (*p == 'j' || *p == 'q' || (*p == 'l' && (p[1] == 'l' || sizeof(long) == 8)) ||
+                ((*p == 'z' || *p == 't') && sizeof(size_t) == 8)) {
+                length = 64;
+            }
+            p++;
+        }
+        char conv = *p;
+        if (conv == '\0') {
+            break;
+        }
+        p++;
+
+        uint64_t arg = a < entry->nargs ? entry->args[a++] : 0;
+        int n = dlog_format_one(&out[len], size - len, spec, spec_len, conv, length, arg);
+        if (n > 0) {
+            len += (size_t)n < size - len ? (size_t)n : size - len - 1;
+        }
+    }
+    out[len] = '\0';
+}
+
+// Tarea de vaciado: saca las entradas de todos los núcleos por orden de instante
+static void dlog_task(void *arg) {
+    char line[DLOG_LINE_SIZE];
+    uint32_t reported = 0;
+
+    for (;;) {
+        for (;;) {
+            // Entrada publicada más antigua entre los núcleos
+            dlog_ring_t *oldest = NULL;
+            dlog_entry_t *entry = NULL;
+            for (int c = 0; c < DLOG_CORES; c++) {
+                dlog_ring_t *ring = &dlog_rings[c];
+                dlog_entry_t *e = &ring->entries[ring->tail & (DLOG_ENTRIES - 1)];
+                if (atomic_load_explicit(&e->seq, memory_order_acquire) != DLOG_LAP(ring->tail) + 1) {
+                    continue;
+                }
+                if (entry == NULL || e->time_us < entry->time_us) {
+                    oldest = ring;
+                    entry = e;
+                }
+            }
+            if (entry == NULL) {
+                break;
+            }
+
+            dlog_format(line, sizeof(line), entry);
+            esp_log_level_t level = entry->level;
+            const char *tag = entry->tag;
+            unsigned long ms = (unsigned long)(entry->time_us / 1000);
+            // Libera la entrada para la siguiente vuelta
+            atomic_store_explicit(&entry->seq, DLOG_LAP(oldest->tail) + DLOG_ENTRIES, memory_order_release);
+            oldest->tail++;
+
+            esp_log_write(level, tag, "%c (%lu) %s: %s\n", dlog_letters[level < sizeof(dlog_letters) ? level : 0],
+                          ms, tag, line);
+        }
+
+        uint32_t dropped = dlog_dropped();
+        if (dropped != reported) {
+            ESP_LOGW(TAG, "%lu log entries dropped (buffer full)", (unsigned long)(dropped - reported));
+            reported = dropped;
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(DLOG_DRAIN_PERIOD_MS));
+    }
+}
+
+#if STATIC_ALLOCATION
+// Tarea de vaciado fuera del heap, como el resto del pipeline (ver STATIC_ALLOCATION)
+static StackType_t dlog_stack[DLOG_TASK_STACK_SIZE / sizeof(StackType_t)];
+static StaticTask_t dlog_tcb;
+#endif
+
+esp_err_t dlog_init(UBaseType_t priority, BaseType_t core) {
+#if STATIC_ALLOCATION
+    if (xTaskCreateStaticPinnedToCore(dlog_task, "dlog", DLOG_TASK_STACK_SIZE, NULL, priority, dlog_stack, &dlog_tcb,
+                                      core) == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+#else
+    if (xTaskCreatePinnedToCore(dlog_task, "dlog", DLOG_TASK_STACK_SIZE, NULL, priority, NULL, core) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+#endif
+    return ESP_OK;
+}
+
+#endif  // DLOG_ENABLE
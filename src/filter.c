@@ -0,0 +1,59 @@
+// filter.c
+
+#include "filter.h"
+
+#include <string.h>
+
+_Static_assert(FILTER_MEDIAN_TAPS >= 1 && FILTER_MEDIAN_TAPS <= 7, "FILTER_MEDIAN_TAPS fuera de rango");
+_Static_assert(FILTER_OVERSAMPLE_LOG2 <= 8, "FILTER_OVERSAMPLE_LOG2 fuera de rango");
+
+void filter_reset(filter_t* filter) {
+    memset(filter, 0, sizeof(*filter));
+}
+
+// Mediana de las lecturas de la ventana (ordenación por inserción de una copia)
+static uint16_t filter_median(const filter_t* filter) {
+    uint16_t sorted[FILTER_MEDIAN_TAPS];
+    uint8_t n = filter->count;
+    for (uint8_t a = 0; a < n; a++) {
+        uint16_t v = filter->window[a];
+        uint8_t b = a;
+        for (; b > 0 && sorted[b - 1] > v; b--) {
+            sorted[b] = sorted[b - 1];
+        }
+        sorted[b] = v;
+    }
+    return (n & 1) ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2] + 1) / 2;
+}
+
+uint16_t filter_update(filter_t* filter, uint16_t q4) {
+    // Mediana móvil: rechaza picos de menos de FILTER_MEDIAN_TAPS / 2 lecturas
+    filter->window[filter->pos] = q4;
+    filter->pos = (filter->pos + 1) % FILTER_MEDIAN_TAPS;
+    if (filter->count < FILTER_MEDIAN_TAPS) {
+        filter->count++;
+    }
+    int32_t x = filter_median(filter);
+
+    // IIR de un polo con el estado escalado para no perder los bits bajos
+    if (!filter->primed) {
+        filter->iir = x << FILTER_IIR_SHIFT;
+        filter->primed = true;
+    } else {
+        filter->iir += x - (filter->iir >> FILTER_IIR_SHIFT);
+    }
+    int32_t y = filter->iir >> FILTER_IIR_SHIFT;
+
+    // Q4 -> LSB redondeado
+    y = (y + (1 << (FILTER_Q - 1))) >> FILTER_Q;
+    return y > 4095 ? 4095 : (uint16_t)y;
+}
+
+uint16_t filter_read(filter_t* filter, therm_t thermistor) {
+    uint32_t sum = 0;
+    for (uint32_t i = 0; i < (1u << FILTER_OVERSAMPLE_LOG2); i++) {
+        sum += therm_read_lsb(thermistor);
+    }
+    // Decimación: media de las conversiones, conservando FILTER_Q bits fraccionarios
+    return filter_update(filter, (uint16_t)((sum << FILTER_Q) >> FILTER_OVERSAMPLE_LOG2));
+}
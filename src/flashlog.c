@@ -0,0 +1,370 @@
+// flashlog.c
+
+#include "flashlog.h"
+
+#if FLASHLOG_ENABLE
+
+#include <esp_crc.h>
+#include <esp_log.h>
+#include <esp_partition.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "spsc_queue.h"
+
+static const char *TAG = "STF_P1:flashlog";
+
+#define FLASHLOG_MAGIC 0x4C46  // "FL"
+#define FLASHLOG_VERSION 1
+#define FLASHLOG_PAGES_PER_SECTOR (FLASHLOG_SECTOR_SIZE / FLASHLOG_PAGE_SIZE)
+
+typedef struct __attribute__((packed)) {
+    uint16_t magic;
+    uint16_t boot;      // Arranque en que se escribió la página
+    uint32_t seq;       // Número de página, creciente durante toda la vida del log
+    uint8_t count;      // Registros válidos
+    uint8_t version;
+    uint16_t reserved;
+    uint32_t crc;       // CRC32 de la página con este campo a 0
+} flashlog_header_t;
+
+typedef struct __attribute__((packed)) {
+    flashlog_header_t header;
+    flashlog_record_t records[FLASHLOG_PAGE_RECORDS];
+} flashlog_page_t;
+
+_Static_assert(sizeof(flashlog_page_t) == FLASHLOG_PAGE_SIZE, "a log page must fill a flash page");
+
+static const esp_partition_t *log_partition = NULL;
+static uint32_t log_pages = 0;
+
+// Productor: página en construcción
+static flashlog_page_t log_open;
+static int64_t log_open_us = 0;  // Instante del primer registro de la página
+static uint16_t log_boot = 0;
+
+// Tarea de escritura: próxima página a programar y su número de secuencia (sólo la tarea
+// de escritura numera las páginas, así que una página descartada no deja hueco)
+static uint32_t log_next_seq = 0;
+static uint32_t log_write_pos = 0;
+static uint32_t log_write_errors = 0;
+
+static spsc_queue_t log_queue;
+
+#if STATIC_ALLOCATION
+// Cola y tarea de escritura fuera del heap, como el resto del pipeline (ver STATIC_ALLOCATION)
+SPSC_QUEUE_STORAGE(log_queue_storage, flashlog_page_t, FLASHLOG_QUEUE_PAGES);
+static StackType_t log_task_stack[FLASHLOG_TASK_STACK_SIZE / sizeof(StackType_t)];
+static StaticTask_t log_task_tcb;
+#endif
+
+// Cierre al reiniciar (ver flashlog_shutdown): el productor marca log_producing mientras
+// toca log_open o la cola y no entra si log_closing ya está puesto; el cierre espera a que
+// salga antes de leer log_open
+static _Atomic bool log_closing = false;
+static _Atomic bool log_producing = false;
+static SemaphoreHandle_t log_closed = NULL;
+static StaticSemaphore_t log_closed_buffer;
+
+static uint32_t flashlog_page_crc(flashlog_page_t *page) {
+    uint32_t crc = page->header.crc;
+    page->header.crc = 0;
+    uint32_t computed = esp_crc32_le(0, (const uint8_t *)page, sizeof(*page));
+    page->header.crc = crc;
+    return computed;
+}
+
+// Lee la página pos; true si es una página del log íntegra
+static bool flashlog_read_page(uint32_t pos, flashlog_page_t *page) {
+    if (esp_partition_read(log_partition, pos * FLASHLOG_PAGE_SIZE, page, sizeof(*page)) != ESP_OK) {
+        return false;
+    }
+    return page->header.magic == FLASHLOG_MAGIC && page->header.version == FLASHLOG_VERSION &&
+           page->header.count <= FLASHLOG_PAGE_RECORDS && flashlog_page_crc(page) == page->header.crc;
+}
+
+// La página pos está borrada (todo 0xFF) y se puede programar
+static bool flashlog_page_blank(uint32_t pos) {
+    uint32_t words[FLASHLOG_PAGE_SIZE / 4];
+    if (esp_partition_read(log_partition, pos * FLASHLOG_PAGE_SIZE, words, sizeof(words)) != ESP_OK) {
+        return false;
+    }
+    for (size_t i = 0; i < FLASHLOG_PAGE_SIZE / 4; i++) {
+        if (words[i] != UINT32_MAX) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Busca la última página escrita y coloca la escritura en la siguiente página en blanco
+static void flashlog_recover(void) {
+    flashlog_page_t page;
+    flashlog_header_t header;
+    bool found = false;
+    uint32_t last_pos = 0;
+
+    for (uint32_t pos = 0; pos < log_pages; pos++) {
+        if (esp_partition_read(log_partition, pos * FLASHLOG_PAGE_SIZE, &header, sizeof(header)) != ESP_OK ||
+            header.magic != FLASHLOG_MAGIC) {
+            continue;
+        }
+        // Sólo se comprueba el CRC de las candidatas a última página
+        if ((!found || (int32_t)(header.seq - log_next_seq) >= 0) && flashlog_read_page(pos, &page)) {
+            found = true;
+            last_pos = pos;
+            log_next_seq = page.header.seq + 1;
+            log_boot = page.header.boot + 1;
+        }
+    }
+
+    if (!found) {
+        // Partición nueva: el primer sector se borra al escribir en él
+        log_write_pos = 0;
+        return;
+    }
+
+    // El resto del sector de la última página estaba borrado, salvo que un corte dejara
+    // una página a medias: se salta hasta una página en blanco o el siguiente sector
+    log_write_pos = (last_pos + 1) % log_pages;
+    while (log_write_pos % FLASHLOG_PAGES_PER_SECTOR != 0 && !flashlog_page_blank(log_write_pos)) {
+        log_write_pos = (log_write_pos + 1) % log_pages;
+    }
+}
+
+// Tarea de escritura: completa la cabecera de una página (el productor sólo pone la
+// cuenta de registros) con el número de secuencia y el CRC
+static void flashlog_seal(flashlog_page_t *page) {
+    // Los registros sin usar quedan como flash borrada
+    memset(&page->records[page->header.count], 0xFF,
+           (FLASHLOG_PAGE_RECORDS - page->header.count) * sizeof(flashlog_record_t));
+    page->header.magic = FLASHLOG_MAGIC;
+    page->header.version = FLASHLOG_VERSION;
+    page->header.boot = log_boot;
+    page->header.seq = log_next_seq++;
+    page->header.reserved = 0;
+    page->header.crc = flashlog_page_crc(page);
+}
+
+// Tarea de escritura: sella una página y la programa en la siguiente posición
+static void flashlog_write_page(flashlog_page_t *page) {
+    flashlog_seal(page);
+
+    // Al entrar en un sector se borra entero (se pierden sus páginas, las más antiguas)
+    size_t offset = log_write_pos * FLASHLOG_PAGE_SIZE;
+    esp_err_t ret = ESP_OK;
+    if (log_write_pos % FLASHLOG_PAGES_PER_SECTOR == 0) {
+        ret = esp_partition_erase_range(log_partition, offset, FLASHLOG_SECTOR_SIZE);
+    }
+    if (ret == ESP_OK) {
+        ret = esp_partition_write(log_partition, offset, page, sizeof(*page));
+    }
+    if (ret != ESP_OK) {
+        log_write_errors++;
+        ESP_LOGW(TAG, "Page %lu not written: %s", (unsigned long)log_write_pos, esp_err_to_name(ret));
+    }
+    log_write_pos = (log_write_pos + 1) % log_pages;
+}
+
+// Tarea de escritura, al cerrar: espera a que el productor salga de su sección (ya no
+// vuelve a entrar), vacía la cola y escribe la página en construcción
+static void flashlog_close(void) {
+    while (atomic_load_explicit(&log_producing, memory_order_seq_cst)) {
+        vTaskDelay(1);
+    }
+
+    flashlog_page_t page;
+    while (spsc_queue_pop(&log_queue, &page)) {
+        flashlog_write_page(&page);
+    }
+    if (log_open.header.count > 0) {
+        flashlog_write_page(&log_open);
+    }
+}
+
+// Tarea de escritura
+static void flashlog_task(void *arg) {
+    flashlog_page_t page;
+
+    for (;;) {
+        // La espera se corta cada FLASHLOG_CLOSE_POLL_MS para atender el cierre
+        if (spsc_queue_receive(&log_queue, &page, pdMS_TO_TICKS(FLASHLOG_CLOSE_POLL_MS))) {
+            flashlog_write_page(&page);
+        }
+
+        if (atomic_load_explicit(&log_closing, memory_order_seq_cst)) {
+            flashlog_close();
+            xSemaphoreGive(log_closed);
+            // El sistema se está reiniciando: no queda nada que escribir
+            for (;;) {
+                vTaskDelay(portMAX_DELAY);
+            }
+        }
+    }
+}
+
+// Manejador de esp_restart(): pide a la tarea de escritura que vacíe el log y la espera
+// como mucho FLASHLOG_SHUTDOWN_TIMEOUT_MS
+static void flashlog_shutdown(void) {
+    atomic_store_explicit(&log_closing, true, memory_order_seq_cst);
+    if (xSemaphoreTake(log_closed, pdMS_TO_TICKS(FLASHLOG_SHUTDOWN_TIMEOUT_MS)) != pdTRUE) {
+        ESP_LOGW(TAG, "Log not closed before restart");
+    }
+}
+
+// Productor: entra en la sección que toca log_open y la cola; false si el log está
+// cerrado o no hay partición. Pareja seq_cst de log_closing/log_producing con el cierre:
+// o el productor ve el cierre, o el cierre le ve dentro y espera
+static bool flashlog_produce_begin(void) {
+    if (log_partition == NULL) {
+        return false;
+    }
+    atomic_store_explicit(&log_producing, true, memory_order_seq_cst);
+    if (atomic_load_explicit(&log_closing, memory_order_seq_cst)) {
+        atomic_store_explicit(&log_producing, false, memory_order_release);
+        return false;
+    }
+    return true;
+}
+
+static void flashlog_produce_end(void) {
+    atomic_store_explicit(&log_producing, false, memory_order_release);
+}
+
+// Productor: envía la página en construcción a la tarea de escritura, que la sella
+static void flashlog_send_open(void) {
+    // Si no cabe, la página se pierde (queda contada en drops de la cola)
+    spsc_queue_send(&log_queue, &log_open);
+    log_open.header.count = 0;
+}
+
+// Añade un registro a la página en RAM y la envía si está llena o es antigua
+static void flashlog_append(flashlog_type_t type, uint8_t arg, int16_t value) {
+    if (!flashlog_produce_begin()) {
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    if (log_open.header.count == 0) {
+        log_open_us = now;
+    }
+    flashlog_record_t *record = &log_open.records[log_open.header.count++];
+    record->time_ms = now / 1000;
+    record->type = type;
+    record->arg = arg;
+    record->value = value;
+
+    if (log_open.header.count == FLASHLOG_PAGE_RECORDS ||
+        (FLASHLOG_FLUSH_MS > 0 && now - log_open_us >= FLASHLOG_FLUSH_MS * 1000LL)) {
+        flashlog_send_open();
+    }
+    flashlog_produce_end();
+}
+
+void flashlog_sample(const sensor_data_t *data) {
+    uint8_t channel = sensor_data_primary(data);
+    flashlog_append(FLASHLOG_SAMPLE, channel, data->temperature[channel]);
+}
+
+void flashlog_state(uint8_t from, uint8_t to) {
+    flashlog_append(FLASHLOG_STATE, from, to);
+}
+
+void flashlog_flush(void) {
+    // Al cerrar, la página en construcción la escribe la tarea de escritura
+    if (!flashlog_produce_begin()) {
+        return;
+    }
+    if (log_open.header.count > 0) {
+        flashlog_send_open();
+    }
+    flashlog_produce_end();
+}
+
+esp_err_t flashlog_foreach(flashlog_visit_t visit, void *ctx) {
+    if (log_partition == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Desde la posición de escritura el recorrido circular va de la página más antigua
+    // a la más reciente; las páginas en blanco o dañadas se saltan
+    flashlog_page_t page;
+    uint32_t start = log_write_pos;
+    for (uint32_t i = 0; i < log_pages; i++) {
+        if (!flashlog_read_page((start + i) % log_pages, &page)) {
+            continue;
+        }
+        for (uint8_t r = 0; r < page.header.count; r++) {
+            visit(page.header.boot, &page.records[r], ctx);
+        }
+    }
+    return ESP_OK;
+}
+
+static void flashlog_print(uint16_t boot, const flashlog_record_t *record, void *ctx) {
+    printf("%u,%lu,%u,%u,%d\n", boot, (unsigned long)record->time_ms, record->type, record->arg, record->value);
+}
+
+void flashlog_dump(void) {
+    printf("boot,time_ms,type,arg,value\n");
+    flashlog_foreach(flashlog_print, NULL);
+}
+
+uint32_t flashlog_dropped(void) {
+    return log_queue.drops + log_write_errors;
+}
+
+esp_err_t flashlog_init(UBaseType_t priority, BaseType_t core) {
+    const esp_partition_t *partition =
+        esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, FLASHLOG_PARTITION);
+    if (partition == NULL) {
+        ESP_LOGW(TAG, "No '%s' partition, sample log disabled", FLASHLOG_PARTITION);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+#if STATIC_ALLOCATION
+    esp_err_t ret =
+        spsc_queue_create_static(&log_queue, sizeof(flashlog_page_t), FLASHLOG_QUEUE_PAGES, log_queue_storage);
+#else
+    esp_err_t ret = spsc_queue_create(&log_queue, sizeof(flashlog_page_t), FLASHLOG_QUEUE_PAGES);
+#endif
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    log_partition = partition;
+    log_pages = (partition->size / FLASHLOG_SECTOR_SIZE) * FLASHLOG_PAGES_PER_SECTOR;
+    flashlog_recover();
+    ESP_LOGI(TAG, "Boot %u, %lu pages, writing at page %lu (seq %lu)", log_boot, (unsigned long)log_pages,
+             (unsigned long)log_write_pos, (unsigned long)log_next_seq);
+
+    log_closed = xSemaphoreCreateBinaryStatic(&log_closed_buffer);
+#if STATIC_ALLOCATION
+    bool started = xTaskCreateStaticPinnedToCore(flashlog_task, "flashlog", FLASHLOG_TASK_STACK_SIZE, NULL, priority,
+                                                 log_task_stack, &log_task_tcb, core) != NULL;
+#else
+    bool started = xTaskCreatePinnedToCore(flashlog_task, "flashlog", FLASHLOG_TASK_STACK_SIZE, NULL, priority, NULL,
+                                           core) == pdPASS;
+#endif
+    if (!started) {
+        log_partition = NULL;
+        spsc_queue_delete(&log_queue);
+        return ESP_ERR_NO_MEM;
+    }
+    // Un esp_restart() (p.ej. por plazos perdidos) no pierde las páginas pendientes
+    ret = esp_register_shutdown_handler(flashlog_shutdown);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Shutdown handler not registered: %s", esp_err_to_name(ret));
+    }
+
+    flashlog_append(FLASHLOG_BOOT, esp_reset_reason(), log_boot);
+    return ESP_OK;
+}
+
+#endif  // FLASHLOG_ENABLE
@@ -0,0 +1,78 @@
+// latency.c
+
+#include "latency.h"
+
+#if LATENCY_TRACE_ENABLE
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <string.h>
+
+static const char *TAG = "STF_P1:latency";
+
+static const char *latency_names[LATENCY_POINTS] = {
+    [LATENCY_SENSOR_READ] = "sensor_read",
+    [LATENCY_SENSOR_SEND] = "sensor_send",
+    [LATENCY_CHECKER_IN] = "checker_in",
+    [LATENCY_CHECKER_OUT] = "checker_out",
+    [LATENCY_MONITOR_IN] = "monitor_in",
+    [LATENCY_MONITOR_CHK_IN] = "monitor_chk_in",
+    [LATENCY_MONITOR_OUT] = "monitor_out",
+};
+
+typedef struct {
+    uint32_t buckets[LATENCY_BUCKETS];  // buckets[b]: latencias con b bits significativos
+    uint32_t count;
+    uint32_t max_us;
+} latency_hist_t;
+
+static latency_hist_t latency_hist[LATENCY_POINTS];
+
+void latency_record(latency_point_t point, uint32_t t0_us) {
+    // La resta en 32 bits es correcta aunque el reloj haya dado la vuelta
+    uint32_t dt = (uint32_t)esp_timer_get_time() - t0_us;
+    uint32_t b = dt ? 32 - __builtin_clz(dt) : 0;
+    if (b >= LATENCY_BUCKETS) {
+        b = LATENCY_BUCKETS - 1;
+    }
+
+    latency_hist_t *h = &latency_hist[point];
+    h->buckets[b]++;
+    h->count++;
+    if (dt > h->max_us) {
+        h->max_us = dt;
+    }
+}
+
+// Límite superior (us) de la cubeta que contiene el percentil pct; la última cubeta
+// no tiene límite y se usa el máximo
+static uint32_t latency_percentile(const latency_hist_t *h, uint32_t count, uint32_t pct) {
+    uint32_t rank = (uint32_t)(((uint64_t)count * pct + 99) / 100);
+    uint32_t acc = 0;
+    for (uint32_t b = 0; b < LATENCY_BUCKETS - 1; b++) {
+        acc += h->buckets[b];
+        if (acc >= rank) {
+            return b ? (1UL << b) - 1 : 0;
+        }
+    }
+    return h->max_us;
+}
+
+void latency_dump(void) {
+    for (int p = 0; p < LATENCY_POINTS; p++) {
+        const latency_hist_t *h = &latency_hist[p];
+        uint32_t count = h->count;
+        if (count == 0) {
+            continue;
+        }
+        ESP_LOGI(TAG, "%-14s n=%lu p50<=%luus p99<=%luus max=%luus", latency_names[p],
+                 (unsigned long)count, (unsigned long)latency_percentile(h, count, 50),
+                 (unsigned long)latency_percentile(h, count, 99), (unsigned long)h->max_us);
+    }
+}
+
+void latency_reset(void) {
+    memset(latency_hist, 0, sizeof(latency_hist));
+}
+
+#endif  // LATENCY_TRACE_ENABLE
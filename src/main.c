@@ -17,28 +17,156 @@
 
 // FreeRTOS headers
 #include <freertos/FreeRTOS.h>
-#include <freertos/ringbuf.h>
 #include <freertos/semphr.h>
 #include <freertos/task.h>
 
 // ESP-IDF headers
 #include <esp_event.h>
+#include <esp_heap_caps.h>
 #include <esp_log.h>
+#include <esp_system.h>
+#include <esp_timer.h>
 #include <nvs_flash.h>
 
 // Project headers
+#include "bench.h"
+#include "boot.h"
+#include "command.h"
 #include "config.h"
 #include "data_structures.h"
+#include "dlog.h"
+#include "flashlog.h"
+#include "sensor_rate.h"
 #include "system.h"
+#include "telemetry.h"
 
 static const char *TAG = "STF_P1:main";
 
+// Task indices in the task table (see TASK_TABLE in config.h)
+enum {
+#define TASK_ID(id, function, period, deadline, wcet, priority, core, stack) TASK_ID_##id,
+    TASK_TABLE(TASK_ID)
+#undef TASK_ID
+    TASK_COUNT
+};
+
+// Timing of each task; the priorities left at 0 are assigned in INIT
+static system_task_timing_t task_timing[TASK_COUNT] = {
+#define TASK_TIMING(id, function, period, deadline, wcet, priority, core, stack) \
+    {#function, (period), (deadline), (wcet), (priority), (core), (stack)},
+    TASK_TABLE(TASK_TIMING)
+#undef TASK_TIMING
+};
+
+// Running tasks of the table, to apply priorities re-derived after a period change
+static system_task_t *task_table[TASK_COUNT];
+
+// Sensor and Monitor run at the sample period: re-derives the rate-monotonic priorities of the
+// table for it, applies them to the tasks already running and checks the schedulability again.
+// Called in INIT and by the Sensor when the period changes at run time (rate command)
+static void task_timing_update(uint32_t period_us) {
+    task_timing[TASK_ID_SENSOR].period_us = period_us;
+    task_timing[TASK_ID_SENSOR].deadline_us = period_us;
+    task_timing[TASK_ID_MONITOR].period_us = period_us;
+    task_timing[TASK_ID_MONITOR].deadline_us = period_us;
+
+    // Priorities left at 0 in the table are assigned again
+#define TASK_PRIORITY(id, function, period, deadline, wcet, fixed_priority, core, stack) \
+    task_timing[TASK_ID_##id].priority = (fixed_priority);
+    TASK_TABLE(TASK_PRIORITY)
+#undef TASK_PRIORITY
+    system_rate_monotonic(task_timing, TASK_COUNT, TASK_PRIORITY_BASE);
+
+    for (size_t i = 0; i < TASK_COUNT; i++) {
+        if (task_table[i] == NULL) {
+            continue;
+        }
+        TaskHandle_t handle = system_task_handle_take(task_table[i]);
+        if (handle != NULL && uxTaskPriorityGet(handle) != task_timing[i].priority) {
+            vTaskPrioritySet(handle, task_timing[i].priority);
+            ESP_LOGI(TAG, "%s: priority %u", task_timing[i].name, (unsigned)task_timing[i].priority);
+        }
+        system_task_handle_give();
+    }
+
+    if (!system_schedulable(task_timing, TASK_COUNT)) {
+        ESP_LOGE(TAG, "Task table not schedulable with a period of %lu us: deadlines may be missed",
+                 (unsigned long)period_us);
+    }
+}
+
+#if STATIC_ALLOCATION && SYSTEM_DISPATCH != SYSTEM_DISPATCH_NOTIFY
+#error "STATIC_ALLOCATION needs SYSTEM_DISPATCH_NOTIFY: the esp_event loop and its task are allocated on the heap"
+#endif
+
+#if STATIC_ALLOCATION
+// Pipeline storage, fixed at link time (see the map file)
+static system_buffers_t sys_buffers;
+#define TASK_STORAGE(id, function, period, deadline, wcet, priority, core, stack) \
+    SYSTEM_TASK_STACK(stack_##id, stack);                                          \
+    static system_task_buffers_t buffers_##id;
+TASK_TABLE(TASK_STORAGE)
+#undef TASK_STORAGE
+SPSC_QUEUE_STORAGE(monitor_storage, sensor_frame_t, QUEUE_LENGTH);
+SPSC_QUEUE_STORAGE(monitor_checker_storage, sensor_frame_t, QUEUE_LENGTH);
+SPSC_QUEUE_STORAGE(checker_storage, sensor_frame_t, QUEUE_LENGTH);
+#define STATIC_STORAGE(x) (x)
+#else
+#define STATIC_STORAGE(x) NULL
+#endif
+
+// Starts a task with its table entry, in the given storage or on the heap without it
+static void start_task(system_t *sys, system_task_t *task, TaskFunction_t function, const system_task_timing_t *timing,
+                       StackType_t *stack, system_task_buffers_t *buffers, void *args) {
+    if (stack != NULL) {
+        system_task_start_in_core_static(sys, task, function, timing->name, stack, timing->stack_depth, args,
+                                         timing->priority, buffers, timing->core);
+    } else {
+        system_task_start_in_core(sys, task, function, timing->name, timing->stack_depth, args, timing->priority,
+                                  timing->core);
+    }
+}
+
+// Creates a frame queue in the given storage, or on the heap without it. Only the valid
+// samples of each frame are copied in and out
+static esp_err_t create_queue(spsc_queue_t *queue, uint8_t *storage) {
+    esp_err_t ret = storage != NULL ? spsc_queue_create_static(queue, sizeof(sensor_frame_t), QUEUE_LENGTH, storage)
+                                    : spsc_queue_create(queue, sizeof(sensor_frame_t), QUEUE_LENGTH);
+    if (ret == ESP_OK) {
+        spsc_queue_set_item_len(queue, sensor_frame_size);
+    }
+    return ret;
+}
+
 // Entry point
 void app_main(void) {
+    boot_mark(BOOT_PHASE_APP_MAIN);
+
+#if DLOG_ENABLE
+    // Drain task of the deferred log, before any task can fill it
+    ESP_ERROR_CHECK(dlog_init(DLOG_TASK_PRIORITY, CORE1));
+#endif
+
+#if BENCH_ENABLE
+    // Benchmarks run before the system and its tasks take over the peripherals
+    bench_run();
+#endif
+
+    // Readiness barrier of the tasks
+    boot_init();
+
+    // Time spent creating the pipeline (system, queues and tasks), to compare both allocation modes
+    int64_t t_start = esp_timer_get_time();
+    int64_t pipeline_us;
+
     // Create a system instance and register states
     system_t sys_stf_p1;
     ESP_LOGI(TAG, "Starting STF_P1 system");
+#if STATIC_ALLOCATION
+    system_create_static(&sys_stf_p1, SYS_NAME, &sys_buffers);
+#else
     system_create(&sys_stf_p1, SYS_NAME);
+#endif
     system_register_state(&sys_stf_p1, INIT);
     system_register_state(&sys_stf_p1, SENSOR_LOOP);
     system_register_state(&sys_stf_p1, NORMAL_MODE);
@@ -46,22 +174,42 @@ void app_main(void) {
     system_register_state(&sys_stf_p1, ERROR);
     system_set_default_state(&sys_stf_p1, INIT);
 
-    // Define task handles
-    system_task_t task_sensor;
-    system_task_t task_checker;
-    system_task_t task_monitor;
+    // Define task handles (zeroed: no field is read before the task start fills it)
+    system_task_t task_sensor = {0};
+    system_task_t task_checker = {0};
+    system_task_t task_monitor = {0};
+#if STATS_ENABLE
+    system_task_t task_stats = {0};
+#endif
 
-    // Create ring buffers for inter-task communication
-    // Ring buffer between Sensor/Monitor and Checker/Monitor
-    RingbufHandle_t monitor_buf = xRingbufferCreate(BUFFER_SIZE, BUFFER_TYPE);
-    // Ring buffer between Sensor and Checker tasks
-    RingbufHandle_t checker_buf = xRingbufferCreate(BUFFER_SIZE, BUFFER_TYPE);
+    // Create SPSC queues for inter-task communication (one per producer/consumer pair)
+    // Queue between Sensor and Monitor tasks
+    spsc_queue_t monitor_buf;
+    // Queue between Checker and Monitor tasks
+    spsc_queue_t monitor_checker_buf;
+    // Queue between Sensor and Checker tasks
+    spsc_queue_t checker_buf;
 
-    // Check if ring buffers were created successfully
-    if (monitor_buf == NULL || checker_buf == NULL) {
-        ESP_LOGE(TAG, "Failed to create ring buffers");
+    // Check if queues were created successfully
+    if (create_queue(&monitor_buf, STATIC_STORAGE(monitor_storage)) != ESP_OK ||
+        create_queue(&monitor_checker_buf, STATIC_STORAGE(monitor_checker_storage)) != ESP_OK ||
+        create_queue(&checker_buf, STATIC_STORAGE(checker_storage)) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create queues");
         return;
     }
+    pipeline_us = esp_timer_get_time() - t_start;
+
+    // Checker transition counters
+    checker_stats_t checker_stats = {0};
+
+    // Samples produced by the Sensor and consumed by the Monitor
+    pipeline_counters_t counters = {0};
+
+    // Sample period, loaded from NVS in INIT
+    sensor_rate_t rate;
+
+    // Every channel of the thermistor group starts in service
+    sensor_group_t group = {.active = (1u << SENSOR_CHANNELS) - 1};
 
     // Variable for return codes
     esp_err_t ret;
@@ -81,37 +229,129 @@ void app_main(void) {
                 ESP_ERROR_CHECK(nvs_flash_init());
             }
 
+            // Sample period of the last run (or SENSOR_FREQUENCY)
+            ESP_ERROR_CHECK_WITHOUT_ABORT(sensor_rate_load(&rate));
+            boot_mark(BOOT_PHASE_NVS);
+
+#if COMMAND_ENABLE
+            // Console commands; the system runs without them if there is no console input
+            command_init(&rate, COMMAND_TASK_PRIORITY, CORE1);
+#endif
+
+#if FLASHLOG_ENABLE
+            // Sample log on flash; the system runs without it if the partition is missing
+            if (flashlog_init(FLASHLOG_TASK_PRIORITY, CORE1) == ESP_OK && FLASHLOG_DUMP_AT_BOOT) {
+                flashlog_dump();
+            }
+#endif
+
+#if TELEMETRY_ENABLE
+            // Binary telemetry port, before the tasks that write to it
+            ESP_ERROR_CHECK(telemetry_init());
+#endif
+
+            // Priorities from the sample period in force, and schedulability of the task table
+            task_table[TASK_ID_SENSOR] = &task_sensor;
+            task_table[TASK_ID_CHECKER] = &task_checker;
+            task_table[TASK_ID_MONITOR] = &task_monitor;
+#if STATS_ENABLE
+            task_table[TASK_ID_STATS] = &task_stats;
+#endif
+            task_timing_update(atomic_load(&rate.period_us));
+
             // Start Sensor task
+            t_start = esp_timer_get_time();
             ESP_LOGI(TAG, "Starting Sensor task...");
              task_sensor_args_t task_sensor_args = {
                 .monitor_buf = &monitor_buf,
                 .checker_buf = &checker_buf,
-                .freq = SENSOR_FREQUENCY,         // Define SENSOR_FREQUENCY in config.h
-                .checker_period = CHECKER_PERIOD  // Define CHECKER_PERIOD in config.h
+                .rate = &rate,                            // Stored in NVS, changed with the rate command
+                .period_changed = task_timing_update,     // Priorities and schedulability for the new period
+                .checker_interval_us = CHECKER_INTERVAL_US,  // Define CHECKER_PERIOD in config.h
+                .counters = &counters,
+                .group = &group
             };
-            system_task_start_in_core(&sys_stf_p1, &task_sensor, TASK_SENSOR, "TASK_SENSOR",
-                                      TASK_SENSOR_STACK_SIZE, &task_sensor_args, 0, CORE0);
+            start_task(&sys_stf_p1, &task_sensor, TASK_SENSOR, &task_timing[TASK_ID_SENSOR],
+                       STATIC_STORAGE(stack_SENSOR), STATIC_STORAGE(&buffers_SENSOR), &task_sensor_args);
             ESP_LOGI(TAG, "Sensor task started");
 
             // Start Checker task
             ESP_LOGI(TAG, "Starting Checker task...");
             task_checker_args_t task_checker_args = {
                 .checker_buf = &checker_buf,
-                .monitor_buf = &monitor_buf};
-            system_task_start_in_core(&sys_stf_p1, &task_checker, TASK_CHECKER, "TASK_CHECKER",
-                                      TASK_CHECKER_STACK_SIZE, &task_checker_args, 0, CORE0);
+                .monitor_buf = &monitor_checker_buf,
+                .stats = &checker_stats,
+                .group = &group};
+            start_task(&sys_stf_p1, &task_checker, TASK_CHECKER, &task_timing[TASK_ID_CHECKER],
+                       STATIC_STORAGE(stack_CHECKER), STATIC_STORAGE(&buffers_CHECKER), &task_checker_args);
             ESP_LOGI(TAG, "Checker task started");
 
             // Start Monitor task
             ESP_LOGI(TAG, "Starting Monitor task...");
             task_monitor_args_t task_monitor_args = {
-                .monitor_buf = &monitor_buf};
-            system_task_start_in_core(&sys_stf_p1, &task_monitor, TASK_MONITOR, "TASK_MONITOR",
-                                      TASK_MONITOR_STACK_SIZE, &task_monitor_args, 0, CORE1);
+                .monitor_buf = &monitor_buf,
+                .monitor_checker_buf = &monitor_checker_buf,
+                .counters = &counters};
+            start_task(&sys_stf_p1, &task_monitor, TASK_MONITOR, &task_timing[TASK_ID_MONITOR],
+                       STATIC_STORAGE(stack_MONITOR), STATIC_STORAGE(&buffers_MONITOR), &task_monitor_args);
             ESP_LOGI(TAG, "Monitor task started");
 
-            // Delay to ensure tasks start properly
-            vTaskDelay(pdMS_TO_TICKS(1000));
+#if STATS_ENABLE
+            // Start Stats task (longest period, lowest priority)
+            ESP_LOGI(TAG, "Starting Stats task...");
+            // Read by Stats on every period, long after this block ends
+            static task_stats_args_t task_stats_args;
+            task_stats_args = (task_stats_args_t){
+                .tasks = {&task_sensor, &task_checker, &task_monitor, &task_stats},
+                .ntasks = 4,
+                .queues = {&monitor_buf, &monitor_checker_buf, &checker_buf},
+                .queue_names = {"mon", "mchk", "chk"},
+                .nqueues = 3,
+                .counters = &counters,
+                .checker = &checker_stats,
+                .group = &group};
+            start_task(&sys_stf_p1, &task_stats, TASK_STATS, &task_timing[TASK_ID_STATS],
+                       STATIC_STORAGE(stack_STATS), STATIC_STORAGE(&buffers_STATS), &task_stats_args);
+            ESP_LOGI(TAG, "Stats task started");
+#endif
+#if BENCH_ENABLE && BENCH_SOAK_S > 0
+            // Soak of the whole pipeline, reported as benchmark results. It runs for
+            // BENCH_SOAK_S, long after this block ends, so its arguments are static
+            static task_stats_args_t soak_args;
+            soak_args = (task_stats_args_t){
+                .tasks = {&task_sensor, &task_checker, &task_monitor},
+                .ntasks = 3,
+                .queues = {&monitor_buf, &monitor_checker_buf, &checker_buf},
+                .queue_names = {"mon", "mchk", "chk"},
+                .nqueues = 3,
+                .counters = &counters,
+                .checker = &checker_stats,
+                .group = &group};
+            bench_soak_start(&soak_args);
+#endif
+            pipeline_us += esp_timer_get_time() - t_start;
+            ESP_LOGI(TAG, "Pipeline created in %lu us (%s allocation), free heap %lu bytes, largest block %lu bytes",
+                     (unsigned long)pipeline_us, STATIC_ALLOCATION ? "static" : "dynamic",
+                     (unsigned long)esp_get_free_heap_size(),
+                     (unsigned long)heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT));
+#if BENCH_ENABLE
+            // Same keys in both allocation modes: bench_compare.py gives the difference
+            bench_result("startup", "pipeline", "create", pipeline_us, "us");
+            bench_result("startup", "pipeline", "heap_free", esp_get_free_heap_size(), "bytes");
+            bench_result("startup", "pipeline", "largest_block_free",
+                         heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT), "bytes");
+#endif
+
+            boot_mark(BOOT_PHASE_TASKS_STARTED);
+
+            // Wait until every task has its resources up (ADC, sample clock, queues)
+            EventBits_t started = BOOT_READY_SENSOR | BOOT_READY_CHECKER | BOOT_READY_MONITOR;
+#if STATS_ENABLE
+            started |= BOOT_READY_STATS;
+#endif
+            if (!boot_wait_ready(started, pdMS_TO_TICKS(BOOT_READY_TIMEOUT_MS))) {
+                ESP_LOGW(TAG, "Starting the loop without every task ready");
+            }
 
             // Transition to SENSOR_LOOP state
             SWITCH_ST(&sys_stf_p1, SENSOR_LOOP);
@@ -128,6 +368,8 @@ void app_main(void) {
         STATE(NORMAL_MODE) {
             STATE_BEGIN();
             ESP_LOGI(TAG, "State: NORMAL_MODE");
+            // First verdict: startup is complete
+            boot_report();
             // Handle normal mode operations
             STATE_END();
         }
@@ -135,6 +377,7 @@ void app_main(void) {
         STATE(DEGRADED_MODE) {
             STATE_BEGIN();
             ESP_LOGI(TAG, "State: DEGRADED_MODE");
+            boot_report();
             // Handle degraded mode operations
             STATE_END();
         }
@@ -142,6 +385,7 @@ void app_main(void) {
         STATE(ERROR) {
             STATE_BEGIN();
             ESP_LOGI(TAG, "State: ERROR");
+            boot_report();
 
             // Stop Sensor task
             ESP_LOGI(TAG, "Stopping Sensor task...");
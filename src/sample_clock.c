@@ -0,0 +1,247 @@
+// sample_clock.c
+
+#include "sample_clock.h"
+
+#include <esp_attr.h>
+#include <esp_timer.h>
+#include <freertos/task.h>
+#include <math.h>
+
+#include "config.h"
+
+#if SAMPLE_CLOCK_SOURCE == SAMPLE_CLOCK_GPTIMER
+#include <driver/gptimer.h>
+#endif
+
+#if SAMPLE_CLOCK_SOURCE == SAMPLE_CLOCK_ESP_TIMER_ISR && !CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
+#error "SAMPLE_CLOCK_ESP_TIMER_ISR requiere CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD=y"
+#endif
+
+// Tarea notificada en cada tick e instante del último tick
+static TaskHandle_t clock_task = NULL;
+static volatile uint32_t clock_tick_us = 0;
+static uint32_t clock_period_us = 0;
+
+#if SAMPLE_CLOCK_SOURCE == SAMPLE_CLOCK_GPTIMER
+static gptimer_handle_t clock_gptimer = NULL;
+#else
+static esp_timer_handle_t clock_timer = NULL;
+#endif
+
+// Jitter: desviaciones de cada intervalo respecto al periodo, en enteros (media y
+// varianza se calculan al consultarlas)
+static portMUX_TYPE jitter_mux = portMUX_INITIALIZER_UNLOCKED;
+static int64_t jitter_last_wake_us = -1;
+static uint32_t jitter_intervals = 0;
+static uint32_t jitter_missed = 0;
+static uint32_t jitter_min_us = UINT32_MAX;
+static uint32_t jitter_max_us = 0;
+static uint32_t jitter_max_wake_us = 0;
+static int64_t jitter_sum_dev = 0;
+static uint64_t jitter_sum_dev2 = 0;
+
+#if SAMPLE_CLOCK_SOURCE == SAMPLE_CLOCK_GPTIMER
+// Alarma del GPTimer (ISR)
+static bool IRAM_ATTR sample_clock_alarm_cb(gptimer_handle_t timer, const gptimer_alarm_event_data_t* edata, void* arg) {
+    BaseType_t woken = pdFALSE;
+    clock_tick_us = (uint32_t)esp_timer_get_time();
+    vTaskNotifyGiveFromISR(clock_task, &woken);
+    return woken == pdTRUE;
+}
+#elif SAMPLE_CLOCK_SOURCE == SAMPLE_CLOCK_ESP_TIMER_ISR
+// Callback de esp_timer despachado desde su ISR
+static void IRAM_ATTR sample_clock_timer_cb(void* arg) {
+    BaseType_t woken = pdFALSE;
+    clock_tick_us = (uint32_t)esp_timer_get_time();
+    vTaskNotifyGiveFromISR(clock_task, &woken);
+    if (woken == pdTRUE) {
+        esp_timer_isr_dispatch_need_yield();
+    }
+}
+#else
+// Callback de esp_timer despachado desde la tarea esp_timer
+static void sample_clock_timer_cb(void* arg) {
+    clock_tick_us = (uint32_t)esp_timer_get_time();
+    xTaskNotifyGive(clock_task);
+}
+#endif
+
+static void sample_clock_jitter_reset(void) {
+    jitter_intervals = 0;
+    jitter_missed = 0;
+    jitter_min_us = UINT32_MAX;
+    jitter_max_us = 0;
+    jitter_max_wake_us = 0;
+    jitter_sum_dev = 0;
+    jitter_sum_dev2 = 0;
+}
+
+esp_err_t sample_clock_start(uint32_t period_us) {
+    if (clock_task != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (period_us == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    clock_task = xTaskGetCurrentTaskHandle();
+    clock_period_us = period_us;
+    portENTER_CRITICAL(&jitter_mux);
+    sample_clock_jitter_reset();
+    jitter_last_wake_us = -1;
+    portEXIT_CRITICAL(&jitter_mux);
+    // Descarta notificaciones anteriores
+    ulTaskNotifyTake(pdTRUE, 0);
+
+    esp_err_t ret;
+#if SAMPLE_CLOCK_SOURCE == SAMPLE_CLOCK_GPTIMER
+    // Contador a 1 MHz que se recarga en cada alarma
+    gptimer_config_t timer_cfg = {
+        .clk_src = GPTIMER_CLK_SRC_DEFAULT,
+        .direction = GPTIMER_COUNT_UP,
+        .resolution_hz = 1000000,
+    };
+    ret = gptimer_new_timer(&timer_cfg, &clock_gptimer);
+    if (ret != ESP_OK) {
+        clock_task = NULL;
+        return ret;
+    }
+    gptimer_event_callbacks_t cbs = {.on_alarm = sample_clock_alarm_cb};
+    gptimer_alarm_config_t alarm_cfg = {
+        .alarm_count = period_us,
+        .reload_count = 0,
+        .flags.auto_reload_on_alarm = true,
+    };
+    ESP_ERROR_CHECK(gptimer_register_event_callbacks(clock_gptimer, &cbs, NULL));
+    ESP_ERROR_CHECK(gptimer_set_alarm_action(clock_gptimer, &alarm_cfg));
+    ESP_ERROR_CHECK(gptimer_enable(clock_gptimer));
+    ret = gptimer_start(clock_gptimer);
+#else
+    esp_timer_create_args_t timer_args = {
+        .callback = &sample_clock_timer_cb,
+#if SAMPLE_CLOCK_SOURCE == SAMPLE_CLOCK_ESP_TIMER_ISR
+        .dispatch_method = ESP_TIMER_ISR,
+#else
+        .dispatch_method = ESP_TIMER_TASK,
+#endif
+        .name = "Sample Clock"};
+    ret = esp_timer_create(&timer_args, &clock_timer);
+    if (ret != ESP_OK) {
+        clock_task = NULL;
+        return ret;
+    }
+    ret = esp_timer_start_periodic(clock_timer, period_us);
+#endif
+    return ret;
+}
+
+bool sample_clock_wait(TickType_t timeout, uint32_t* tick_us) {
+    uint32_t pending = ulTaskNotifyTake(pdTRUE, timeout);
+    if (pending == 0) {
+        return false;
+    }
+    int64_t now = esp_timer_get_time();
+    uint32_t tick = clock_tick_us;
+    *tick_us = tick;
+
+    portENTER_CRITICAL(&jitter_mux);
+    // Más de una notificación acumulada: la tarea no atendió todos los ticks
+    jitter_missed += pending - 1;
+    uint32_t wake_us = (uint32_t)now - tick;
+    if (wake_us > jitter_max_wake_us) {
+        jitter_max_wake_us = wake_us;
+    }
+    // Un intervalo que abarca ticks perdidos no mide jitter (ya se cuenta en missed)
+    if (jitter_last_wake_us >= 0 && pending == 1) {
+        uint32_t interval_us = now - jitter_last_wake_us;
+        int32_t dev = (int32_t)(interval_us - clock_period_us);
+        jitter_intervals++;
+        jitter_sum_dev += dev;
+        jitter_sum_dev2 += (int64_t)dev * dev;
+        if (interval_us < jitter_min_us) {
+            jitter_min_us = interval_us;
+        }
+        if (interval_us > jitter_max_us) {
+            jitter_max_us = interval_us;
+        }
+    }
+    jitter_last_wake_us = now;
+    portEXIT_CRITICAL(&jitter_mux);
+    return true;
+}
+
+esp_err_t sample_clock_stop(void) {
+    if (clock_task == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+#if SAMPLE_CLOCK_SOURCE == SAMPLE_CLOCK_GPTIMER
+    ESP_ERROR_CHECK(gptimer_stop(clock_gptimer));
+    ESP_ERROR_CHECK(gptimer_disable(clock_gptimer));
+    ESP_ERROR_CHECK(gptimer_del_timer(clock_gptimer));
+    clock_gptimer = NULL;
+#else
+    ESP_ERROR_CHECK(esp_timer_stop(clock_timer));
+    ESP_ERROR_CHECK(esp_timer_delete(clock_timer));
+    clock_timer = NULL;
+#endif
+    clock_task = NULL;
+    return ESP_OK;
+}
+
+esp_err_t sample_clock_set_period(uint32_t period_us) {
+    if (clock_task == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (period_us == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t ret;
+#if SAMPLE_CLOCK_SOURCE == SAMPLE_CLOCK_GPTIMER
+    // La alarma se recarga desde 0: con el contador a 0 el periodo nuevo empieza ahora
+    gptimer_alarm_config_t alarm_cfg = {
+        .alarm_count = period_us,
+        .reload_count = 0,
+        .flags.auto_reload_on_alarm = true,
+    };
+    ret = gptimer_set_raw_count(clock_gptimer, 0);
+    if (ret == ESP_OK) {
+        ret = gptimer_set_alarm_action(clock_gptimer, &alarm_cfg);
+    }
+#else
+    ret = esp_timer_restart(clock_timer, period_us);
+#endif
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    ulTaskNotifyTake(pdTRUE, 0);
+    portENTER_CRITICAL(&jitter_mux);
+    clock_period_us = period_us;
+    sample_clock_jitter_reset();
+    jitter_last_wake_us = -1;
+    portEXIT_CRITICAL(&jitter_mux);
+    return ESP_OK;
+}
+
+void sample_clock_jitter(sample_clock_jitter_t* jitter, bool reset) {
+    portENTER_CRITICAL(&jitter_mux);
+    uint32_t n = jitter_intervals;
+    int64_t sum_dev = jitter_sum_dev;
+    uint64_t sum_dev2 = jitter_sum_dev2;
+    jitter->intervals = n;
+    jitter->missed = jitter_missed;
+    jitter->min_us = n ? jitter_min_us : 0;
+    jitter->max_us = jitter_max_us;
+    jitter->max_wake_us = jitter_max_wake_us;
+    if (reset) {
+        sample_clock_jitter_reset();
+    }
+    portEXIT_CRITICAL(&jitter_mux);
+
+    // Fuera de la sección crítica: varianza = E[dev^2] - E[dev]^2
+    float mean_dev = n ? (float)sum_dev / n : 0.0f;
+    float var = n ? (float)sum_dev2 / n - mean_dev * mean_dev : 0.0f;
+    jitter->mean_us = n ? clock_period_us + mean_dev : 0.0f;
+    jitter->stddev_us = var > 0.0f ? sqrtf(var) : 0.0f;
+}
@@ -0,0 +1,61 @@
+// sensor_rate.c
+
+#include "sensor_rate.h"
+
+#include <esp_log.h>
+#include <nvs.h>
+
+static const char *TAG = "STF_P1:sensor_rate";
+
+#define SENSOR_RATE_NVS_NAMESPACE "sensor"
+#define SENSOR_RATE_NVS_KEY "period_us"
+
+static bool sensor_rate_valid(uint32_t period_us) {
+    return period_us >= SENSOR_PERIOD_MIN_US && period_us <= SENSOR_PERIOD_MAX_US;
+}
+
+esp_err_t sensor_rate_load(sensor_rate_t *rate) {
+    uint32_t period_us = SENSOR_DEFAULT_PERIOD_US;
+    nvs_handle_t nvs;
+    esp_err_t ret = nvs_open(SENSOR_RATE_NVS_NAMESPACE, NVS_READONLY, &nvs);
+    if (ret == ESP_OK) {
+        uint32_t stored;
+        ret = nvs_get_u32(nvs, SENSOR_RATE_NVS_KEY, &stored);
+        nvs_close(nvs);
+        if (ret == ESP_OK && sensor_rate_valid(stored)) {
+            period_us = stored;
+        } else if (ret == ESP_OK) {
+            ESP_LOGW(TAG, "Stored period %lu us out of range, using the default", (unsigned long)stored);
+        }
+    }
+    // Sin namespace o sin clave: primer arranque, se usa el valor por defecto
+    if (ret == ESP_ERR_NVS_NOT_FOUND) {
+        ret = ESP_OK;
+    }
+
+    atomic_store(&rate->period_us, period_us);
+    ESP_LOGI(TAG, "Sample period %lu us", (unsigned long)period_us);
+    return ret;
+}
+
+esp_err_t sensor_rate_set(sensor_rate_t *rate, uint32_t period_us) {
+    if (!sensor_rate_valid(period_us)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (atomic_exchange(&rate->period_us, period_us) == period_us) {
+        return ESP_OK;
+    }
+
+    // Sólo se escribe en NVS cuando el periodo cambia
+    nvs_handle_t nvs;
+    esp_err_t ret = nvs_open(SENSOR_RATE_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = nvs_set_u32(nvs, SENSOR_RATE_NVS_KEY, period_us);
+    if (ret == ESP_OK) {
+        ret = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    return ret;
+}
@@ -0,0 +1,155 @@
+// spsc_queue.c
+
+#include "spsc_queue.h"
+
+#include <esp_heap_caps.h>
+#include <string.h>
+
+static bool spsc_queue_valid(size_t item_size, size_t capacity) {
+    return item_size != 0 && capacity != 0 && (capacity & (capacity - 1)) == 0;
+}
+
+static void spsc_queue_init(spsc_queue_t *q, size_t item_size, size_t capacity) {
+    q->mask = capacity - 1;
+    q->item_size = item_size;
+    q->item_len = NULL;
+
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+    atomic_init(&q->waiting, false);
+    atomic_init(&q->consumer, NULL);
+    q->tail_cache = 0;
+    q->head_cache = 0;
+    q->drops = 0;
+}
+
+esp_err_t spsc_queue_create(spsc_queue_t *q, size_t item_size, size_t capacity) {
+    if (!spsc_queue_valid(item_size, capacity)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    q->storage = heap_caps_aligned_alloc(SPSC_QUEUE_ALIGN, item_size * capacity, MALLOC_CAP_DEFAULT);
+    if (q->storage == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    q->static_storage = false;
+    spsc_queue_init(q, item_size, capacity);
+    return ESP_OK;
+}
+
+esp_err_t spsc_queue_create_static(spsc_queue_t *q, size_t item_size, size_t capacity, uint8_t *storage) {
+    if (!spsc_queue_valid(item_size, capacity) || storage == NULL || ((uintptr_t)storage % SPSC_QUEUE_ALIGN) != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    q->storage = storage;
+    q->static_storage = true;
+    spsc_queue_init(q, item_size, capacity);
+    return ESP_OK;
+}
+
+void spsc_queue_delete(spsc_queue_t *q) {
+    if (!q->static_storage) {
+        heap_caps_free(q->storage);
+    }
+    q->storage = NULL;
+}
+
+void spsc_queue_set_item_len(spsc_queue_t *q, size_t (*item_len)(const void *item)) {
+    q->item_len = item_len;
+}
+
+// Bytes a copiar de un registro: los útiles si la cola los conoce, sin pasar del hueco
+static inline size_t spsc_queue_item_len(const spsc_queue_t *q, const void *item) {
+    if (q->item_len == NULL) {
+        return q->item_size;
+    }
+    size_t len = q->item_len(item);
+    return len < q->item_size ? len : q->item_size;
+}
+
+bool spsc_queue_send(spsc_queue_t *q, const void *item) {
+    uint32_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+
+    // Sólo se relee la tail del consumidor cuando la copia local dice que está llena
+    if (head - q->tail_cache > q->mask) {
+        q->tail_cache = atomic_load_explicit(&q->tail, memory_order_acquire);
+        if (head - q->tail_cache > q->mask) {
+            q->drops++;
+            return false;
+        }
+    }
+
+    memcpy(&q->storage[(head & q->mask) * q->item_size], item, spsc_queue_item_len(q, item));
+    atomic_store_explicit(&q->head, head + 1, memory_order_release);
+
+    // Pareja del store de `waiting` en spsc_queue_wait: o el consumidor ve la nueva
+    // head antes de dormir, o el productor ve `waiting` y le notifica
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&q->waiting, memory_order_relaxed) &&
+        atomic_exchange_explicit(&q->waiting, false, memory_order_relaxed)) {
+        xTaskNotifyGive(atomic_load_explicit(&q->consumer, memory_order_relaxed));
+    }
+
+    return true;
+}
+
+bool spsc_queue_pop(spsc_queue_t *q, void *item) {
+    uint32_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+
+    if (tail == q->head_cache) {
+        q->head_cache = atomic_load_explicit(&q->head, memory_order_acquire);
+        if (tail == q->head_cache) {
+            return false;
+        }
+    }
+
+    // El acquire de head hace visible el registro entero, también su longitud
+    const uint8_t *slot = &q->storage[(tail & q->mask) * q->item_size];
+    memcpy(item, slot, spsc_queue_item_len(q, slot));
+    atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+
+    return true;
+}
+
+bool spsc_queue_wait(spsc_queue_t *const *queues, size_t count, TickType_t ticks_to_wait) {
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    TimeOut_t timeout;
+    vTaskSetTimeOutState(&timeout);
+
+    for (;;) {
+        bool ready = false;
+        for (size_t i = 0; i < count; i++) {
+            atomic_store_explicit(&queues[i]->consumer, self, memory_order_relaxed);
+            atomic_store_explicit(&queues[i]->waiting, true, memory_order_relaxed);
+        }
+        atomic_thread_fence(memory_order_seq_cst);
+        for (size_t i = 0; i < count && !ready; i++) {
+            ready = spsc_queue_count(queues[i]) != 0;
+        }
+
+        if (!ready) {
+            ulTaskNotifyTake(pdTRUE, ticks_to_wait);
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            atomic_store_explicit(&queues[i]->waiting, false, memory_order_relaxed);
+        }
+        for (size_t i = 0; i < count && !ready; i++) {
+            ready = spsc_queue_count(queues[i]) != 0;
+        }
+
+        // Una notificación de un envío que ya se había visto antes de dormir despierta a
+        // la tarea con las colas vacías: se vuelve a esperar el tiempo que quede
+        if (ready || xTaskCheckForTimeOut(&timeout, &ticks_to_wait) != pdFALSE) {
+            return ready;
+        }
+    }
+}
+
+bool spsc_queue_receive(spsc_queue_t *q, void *item, TickType_t ticks_to_wait) {
+    if (spsc_queue_pop(q, item)) {
+        return true;
+    }
+    return spsc_queue_wait(&q, 1, ticks_to_wait) && spsc_queue_pop(q, item);
+}
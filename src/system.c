@@ -11,6 +11,8 @@
 * AUTHOR :   Dr. Fernando Leon (fernando.leon@uco.es) University of Cordoba
 ******************************************************************************/
 
+#include <math.h>
+#include <stdbool.h>
 #include <string.h>
 
 #include <freertos/FreeRTOS.h>
@@ -24,7 +26,13 @@
 
 static const char *TAG = "system";
 
+// handles of the system tasks: system_task_stop deletes a task only while no other task is
+// querying it through system_task_handle_take (shared by every system, static storage)
+static SemaphoreHandle_t sys_task_handle_mutex = NULL;
+static StaticSemaphore_t sys_task_handle_mutex_buffer;
 
+
+#if SYSTEM_DISPATCH == SYSTEM_DISPATCH_EVENT_LOOP
 static void __on_sys_state_change(void* handler_arg, esp_event_base_t base, int32_t id, void* ptr)
 {
 	system_t *system = (system_t *) handler_arg;
@@ -33,21 +41,30 @@ static void __on_sys_state_change(void* handler_arg, esp_event_base_t base, int3
 	xSemaphoreGive(system->sys_new_state);
 	xSemaphoreGive(system->sys_st_mutex);
 }
+#endif
 
-// system create
-void system_create(system_t* sys, const char* id)
+// (common private) system create, with the semaphores already created
+
+static void __system_create(system_t* sys, const char* id)
 {
-	char evt_loop_task_name[32] = "";
-	
-	//mutex(s) 
-	sys->sys_st_mutex = xSemaphoreCreateBinary();
-	sys->sys_new_state = xSemaphoreCreateBinary();
+	if (sys_task_handle_mutex == NULL)
+	{
+		sys_task_handle_mutex = xSemaphoreCreateMutexStatic(&sys_task_handle_mutex_buffer);
+	}
 	sys->sys_nstates = 0;
+	sys->sys_run_state = 0xFF;
+	memset(sys->sys_states, 0, sizeof(sys->sys_states));
 	
 	// name
 	// strlen(id) < 16
 	strcpy(sys->sys_id, id);
 	
+#if SYSTEM_DISPATCH == SYSTEM_DISPATCH_NOTIFY
+	// the creator runs the state machine and receives the new states as notifications
+	sys->sys_owner = xTaskGetCurrentTaskHandle();
+#else
+	char evt_loop_task_name[32] = "";
+
 	// system event loop
 	strcat(evt_loop_task_name, id);
 	strcat(evt_loop_task_name, "__evt_loop_task");
@@ -57,46 +74,141 @@ void system_create(system_t* sys, const char* id)
 	sys->sys_evt_loop_args.task_stack_size = 3072;
 	sys->sys_evt_loop_args.task_core_id = tskNO_AFFINITY;
 	esp_event_loop_create(&(sys->sys_evt_loop_args), &(sys->sys_evt_loop));
+#endif
+}
+
+// system create
+void system_create(system_t* sys, const char* id)
+{
+	//mutex(s) 
+	sys->sys_st_mutex = xSemaphoreCreateBinary();
+#if SYSTEM_DISPATCH == SYSTEM_DISPATCH_EVENT_LOOP
+	sys->sys_new_state = xSemaphoreCreateBinary();
+#endif
+	__system_create(sys, id);
+}
+
+// system create (static storage)
+void system_create_static(system_t* sys, const char* id, system_buffers_t* buffers)
+{
+	sys->sys_st_mutex = xSemaphoreCreateBinaryStatic(&buffers->sys_st_mutex);
+#if SYSTEM_DISPATCH == SYSTEM_DISPATCH_EVENT_LOOP
+	sys->sys_new_state = xSemaphoreCreateBinaryStatic(&buffers->sys_new_state);
+#endif
+	__system_create(sys, id);
+}
+
+// system delete
+
+void system_delete(system_t *sys)
+{
+#if SYSTEM_DISPATCH == SYSTEM_DISPATCH_EVENT_LOOP
+	esp_event_loop_delete(sys->sys_evt_loop);
+	sys->sys_evt_loop = NULL;
+	vSemaphoreDelete(sys->sys_new_state);
+#endif
+	vSemaphoreDelete(sys->sys_st_mutex);
+	sys->sys_nstates = 0;
 }
 
 // system add state
 
 void system_register_state(system_t *sys, uint8_t st)
 {
+	configASSERT(st < SYSTEM_MAX_STATES);
+#if SYSTEM_DISPATCH == SYSTEM_DISPATCH_EVENT_LOOP
 	esp_event_handler_register_with(sys->sys_evt_loop, (esp_event_base_t) sys->sys_id, st, __on_sys_state_change, sys);
+#endif
 	sys->sys_nstates+=1;
 }
 
+// system state hooks
+
+void system_register_state_hooks(system_t *sys, uint8_t st, system_state_hook_t on_entry, system_state_hook_t on_exit, void *arg)
+{
+	configASSERT(st < SYSTEM_MAX_STATES);
+	sys->sys_states[st].on_entry = on_entry;
+	sys->sys_states[st].on_exit = on_exit;
+	sys->sys_states[st].arg = arg;
+}
+
 // system set default state
 
 void system_set_default_state(system_t *sys, uint8_t default_st)
 {
 	sys->sys_state = default_st;
+#if SYSTEM_DISPATCH == SYSTEM_DISPATCH_NOTIFY
+	xTaskNotify(sys->sys_owner, default_st, eSetValueWithOverwrite);
+#else
 	if (!uxSemaphoreGetCount(sys->sys_new_state))
 		xSemaphoreGive(sys->sys_new_state);
+#endif
+}
+
+// system switch state
+
+void system_switch_state(system_t *sys, uint8_t st)
+{
+#if SYSTEM_DISPATCH == SYSTEM_DISPATCH_NOTIFY
+	// the new state is visible at once; the owner is woken with the latest one
+	sys->sys_state = st;
+	xTaskNotify(sys->sys_owner, st, eSetValueWithOverwrite);
+#else
+	esp_event_post_to(sys->sys_evt_loop, (esp_event_base_t) sys->sys_id, st, NULL, 0, portMAX_DELAY);
+#endif
+}
+
+// system wait state (state machine task)
+
+BaseType_t system_wait_state(system_t *sys, TickType_t ticks_to_wait)
+{
+#if SYSTEM_DISPATCH == SYSTEM_DISPATCH_NOTIFY
+	uint32_t st;
+	if (xTaskNotifyWait(0, UINT32_MAX, &st, ticks_to_wait) != pdTRUE)
+		return pdFALSE;
+#else
+	if (xSemaphoreTake(sys->sys_new_state, ticks_to_wait) != pdTRUE)
+		return pdFALSE;
+#endif
+
+	// hooks of the state left and the state entered
+	uint8_t new_st = sys->sys_state;
+	if (new_st != sys->sys_run_state)
+	{
+		if (sys->sys_run_state < SYSTEM_MAX_STATES && sys->sys_states[sys->sys_run_state].on_exit)
+			sys->sys_states[sys->sys_run_state].on_exit(sys->sys_states[sys->sys_run_state].arg);
+		if (new_st < SYSTEM_MAX_STATES && sys->sys_states[new_st].on_entry)
+			sys->sys_states[new_st].on_entry(sys->sys_states[new_st].arg);
+		sys->sys_run_state = new_st;
+	}
+	return pdTRUE;
 }
 
 // (common private) system task start
 
-static void __system_task_start(system_t *sys, system_task_t *task, void* args)
+static void __system_task_start(system_t *sys, system_task_t *task, void* args, StaticSemaphore_t *stop_buffer)
 {
 	// system
 	task->system = sys; 
+	task->sys_task_handler = NULL;
 	
-	// mutex to stop the task
+	// mutex to stop the task (in the caller storage if given)
 	
-	task->sys_task_stop = xSemaphoreCreateBinary();
+	task->sys_task_stop = stop_buffer ? xSemaphoreCreateBinaryStatic(stop_buffer) : xSemaphoreCreateBinary();
 	xSemaphoreGive(task->sys_task_stop);
 
 	// args
 	task->sys_task_args = args;
+
+	// not watched until system_task_watchdog
+	task->sys_task_wdt = false;
 }
 
 // system task start
 void system_task_start(system_t *sys, system_task_t *task, TaskFunction_t function, const char * const name, configSTACK_DEPTH_TYPE stack_depth, void* args, UBaseType_t priority)
 {
 	
-	__system_task_start(sys, task, args);
+	__system_task_start(sys, task, args, NULL);
 	
 	// creation 
 	xTaskCreate( function, name, stack_depth, task, priority, &(task->sys_task_handler));
@@ -109,13 +221,24 @@ void system_task_start(system_t *sys, system_task_t *task, TaskFunction_t functi
 
 void system_task_start_in_core(system_t *sys, system_task_t *task, TaskFunction_t function, const char * const name, configSTACK_DEPTH_TYPE stack_depth, void* args, UBaseType_t priority, BaseType_t coreid)
 {
-	__system_task_start(sys, task, args);
+	__system_task_start(sys, task, args, NULL);
 	
 	// creation 
 	xTaskCreatePinnedToCore( function, name, stack_depth, task, priority, &task->sys_task_handler, coreid);
 	configASSERT(task->sys_task_handler );
 }
 
+// system task start in a specific core (static storage)
+
+void system_task_start_in_core_static(system_t *sys, system_task_t *task, TaskFunction_t function, const char * const name, StackType_t *stack, configSTACK_DEPTH_TYPE stack_depth, void* args, UBaseType_t priority, system_task_buffers_t *buffers, BaseType_t coreid)
+{
+	__system_task_start(sys, task, args, &buffers->sys_task_stop);
+	
+	// creation: nothing is taken from the heap
+	task->sys_task_handler = xTaskCreateStaticPinnedToCore( function, name, stack_depth, task, priority, stack, &buffers->sys_task_tcb, coreid);
+	configASSERT(task->sys_task_handler );
+}
+
 // system task stop 
 
 void system_task_stop(system_t *sys, system_task_t *task, uint16_t timeout_ms)
@@ -127,9 +250,141 @@ void system_task_stop(system_t *sys, system_task_t *task, uint16_t timeout_ms)
 	{
 		ESP_LOGW(TAG, "Task stop timeout");	
 	}
+	// a task that did not reach TASK_END is still subscribed
+	system_task_watchdog(task, false);
+	xSemaphoreTake(sys_task_handle_mutex, portMAX_DELAY);
 	vTaskDelete(task->sys_task_handler);
 	task->sys_task_handler = NULL;
+	xSemaphoreGive(sys_task_handle_mutex);
 	vSemaphoreDelete(task->sys_task_stop);
 	task->sys_task_args = NULL;
 	task-> system = NULL; 
 }
+
+// system task handle for queries from other tasks
+
+TaskHandle_t system_task_handle_take(system_task_t *task)
+{
+	xSemaphoreTake(sys_task_handle_mutex, portMAX_DELAY);
+	return task->sys_task_handler;
+}
+
+void system_task_handle_give(void)
+{
+	xSemaphoreGive(sys_task_handle_mutex);
+}
+
+// system task watchdog
+
+esp_err_t system_task_watchdog(system_task_t *task, bool enable)
+{
+#if CONFIG_ESP_TASK_WDT_EN
+	if (enable == task->sys_task_wdt)
+	{
+		return ESP_OK;
+	}
+	// NULL would subscribe the calling task instead
+	if (task->sys_task_handler == NULL)
+	{
+		return ESP_ERR_INVALID_STATE;
+	}
+	esp_err_t ret = enable ? esp_task_wdt_add(task->sys_task_handler) : esp_task_wdt_delete(task->sys_task_handler);
+	if (ret == ESP_OK)
+	{
+		task->sys_task_wdt = enable;
+	}
+	else
+	{
+		ESP_LOGW(TAG, "Task watchdog %s failed: %s", enable ? "add" : "delete", esp_err_to_name(ret));
+	}
+	return ret;
+#else
+	return enable ? ESP_ERR_NOT_SUPPORTED : ESP_OK;
+#endif
+}
+
+// rate-monotonic priorities
+
+void system_rate_monotonic(system_task_timing_t *tasks, size_t count, UBaseType_t base_priority)
+{
+	// tasks to assign (priority 0 on entry)
+	configASSERT(count <= 32);
+	uint32_t automatic = 0;
+	for (size_t i = 0; i < count; i++)
+		if (tasks[i].priority == 0)
+			automatic |= 1u << i;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		if (!(automatic & (1u << i)))
+			continue;
+
+		// one level above each distinct longer period among the tasks being assigned
+		UBaseType_t priority = base_priority;
+		for (size_t j = 0; j < count; j++)
+		{
+			if (!(automatic & (1u << j)) || tasks[j].period_us <= tasks[i].period_us)
+				continue;
+			bool counted = false;
+			for (size_t k = 0; k < j; k++)
+				counted = counted || ((automatic & (1u << k)) && tasks[k].period_us == tasks[j].period_us);
+			if (!counted)
+				priority++;
+		}
+		tasks[i].priority = priority;
+	}
+}
+
+// schedulability check (response-time analysis per core)
+
+bool system_schedulable(const system_task_timing_t *tasks, size_t count)
+{
+	bool schedulable = true;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		// R = C_i + sum over the other tasks of the core with priority >= P_i of ceil(R / T_j) * C_j
+		uint64_t response = tasks[i].wcet_us;
+		uint64_t previous = 0;
+		while (response != previous && response <= tasks[i].deadline_us)
+		{
+			previous = response;
+			response = tasks[i].wcet_us;
+			for (size_t j = 0; j < count; j++)
+			{
+				if (j == i || tasks[j].core != tasks[i].core || tasks[j].priority < tasks[i].priority)
+					continue;
+				response += (previous + tasks[j].period_us - 1) / tasks[j].period_us * tasks[j].wcet_us;
+			}
+		}
+
+		bool ok = response <= tasks[i].deadline_us;
+		schedulable = schedulable && ok;
+		if (ok)
+			ESP_LOGI(TAG, "%s: core %d, priority %u, response %lu us <= deadline %lu us", tasks[i].name, (int)tasks[i].core,
+			         (unsigned)tasks[i].priority, (unsigned long)response, (unsigned long)tasks[i].deadline_us);
+		else
+			ESP_LOGE(TAG, "%s: core %d, priority %u, misses its deadline of %lu us", tasks[i].name, (int)tasks[i].core,
+			         (unsigned)tasks[i].priority, (unsigned long)tasks[i].deadline_us);
+	}
+
+	// utilization of each core against the Liu & Layland bound n (2^(1/n) - 1)
+	for (BaseType_t core = 0; core < portNUM_PROCESSORS; core++)
+	{
+		float utilization = 0.0f;
+		int n = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			if (tasks[i].core == core)
+			{
+				utilization += (float)tasks[i].wcet_us / tasks[i].period_us;
+				n++;
+			}
+		}
+		if (n > 0)
+			ESP_LOGI(TAG, "core %d: %d tasks, utilization %.1f%% (rate-monotonic bound %.1f%%)", (int)core, n,
+			         utilization * 100.0f, n * (powf(2.0f, 1.0f / n) - 1.0f) * 100.0f);
+	}
+
+	return schedulable;
+}
@@ -4,16 +4,103 @@
 #include <esp_log.h>
 #include <esp_system.h>
 #include <freertos/FreeRTOS.h>
-#include <freertos/ringbuf.h>
 #include <math.h>
 #include <string.h>
 
+#include "boot.h"
 #include "config.h"
 #include "data_structures.h"
+#include "dlog.h"
+#include "latency.h"
 #include "system.h"
+#include "window_stats.h"
 
 static const char* TAG = "STF_P1:task_checker";
 
+// Target state for the deviation statistics, with hysteresis around the DEGRADED_MODE
+// threshold. The EWMA smooths out a single noisy pair. ERROR needs a full window whose
+// mean reaches the ERROR threshold and where every deviation is degraded: the window is
+// its own debounce, so that verdict is posted without further confirmation
+static uint8_t checker_classify(const window_summary_t* window, uint8_t current) {
+    if (window->count == WINDOW_STATS_SIZE && window->mean >= CHECKER_ERROR_ENTER &&
+        window->min >= CHECKER_DEGRADED_ENTER) {
+        return ERROR;
+    }
+    if (current == DEGRADED_MODE) {
+        return window->ewma > CHECKER_DEGRADED_EXIT ? DEGRADED_MODE : NORMAL_MODE;
+    }
+    return window->ewma > CHECKER_DEGRADED_ENTER ? DEGRADED_MODE : NORMAL_MODE;
+}
+
+// Median of n readings (insertion sort: n <= SENSOR_CHANNELS, at most 6)
+static int16_t checker_median(int16_t* values, uint8_t n) {
+    for (uint8_t a = 1; a < n; a++) {
+        int16_t v = values[a];
+        uint8_t b = a;
+        for (; b > 0 && values[b - 1] > v; b--) {
+            values[b] = values[b - 1];
+        }
+        values[b] = v;
+    }
+    return (n & 1) ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+
+// Votes over the channels of a sample that are still in service. Returns the least
+// severe state the vote allows, leaves in *deviation the deviation of the channels that
+// agree (for the statistics) and in *outliers the channels that disagree with the majority
+static uint8_t checker_vote(const sensor_data_t* data, uint8_t active, float* deviation, uint8_t* outliers) {
+    const uint8_t all = (1u << SENSOR_CHANNELS) - 1;
+    int16_t values[SENSOR_CHANNELS];
+    uint8_t n = 0;
+
+    *outliers = 0;
+    *deviation = 0.0f;
+    for (uint8_t c = 0; c < SENSOR_CHANNELS; c++) {
+        if (active & (1u << c)) {
+            values[n++] = data->temperature[c];
+        }
+    }
+    if (n < 2) {
+        return ERROR;
+    }
+
+    if (n == 2) {
+        // No majority with two channels: deviation of the pair, as a plain duplex
+        float t_a = cdeg_to_celsius(values[0]);
+        *deviation = fabsf(t_a - cdeg_to_celsius(values[1])) / t_a;
+    } else {
+        // Every channel against the median of the group
+        float median = cdeg_to_celsius(checker_median(values, n));
+        float max_all = 0.0f;
+        uint8_t agree = 0;
+        for (uint8_t c = 0; c < SENSOR_CHANNELS; c++) {
+            if (!(active & (1u << c))) {
+                continue;
+            }
+            float channel_deviation = fabsf(cdeg_to_celsius(data->temperature[c]) - median) / median;
+            if (channel_deviation > max_all) max_all = channel_deviation;
+            if (channel_deviation > CHECKER_DEGRADED_ENTER) {
+                *outliers |= 1u << c;
+            } else {
+                agree++;
+                if (channel_deviation > *deviation) *deviation = channel_deviation;
+            }
+        }
+        if (agree * 2 <= n) {
+            // Without a majority the outliers cannot be told apart from the good channels
+            *outliers = 0;
+            *deviation = max_all;
+            return ERROR;
+        }
+        if (*outliers) {
+            return DEGRADED_MODE;
+        }
+    }
+
+    // Running with channels already dropped is degraded operation
+    return active != all ? DEGRADED_MODE : NORMAL_MODE;
+}
+
 // Checker Task
 SYSTEM_TASK(TASK_CHECKER) {
     TASK_BEGIN();
@@ -21,49 +108,112 @@ SYSTEM_TASK(TASK_CHECKER) {
 
     // Retrieve the task arguments
     task_checker_args_t* ptr_args = (task_checker_args_t*)TASK_ARGS;
-    RingbufHandle_t* checker_buf = ptr_args->checker_buf;  // Input RingBuffer from Sensor task
-    RingbufHandle_t* monitor_buf = ptr_args->monitor_buf;  // Output RingBuffer to Monitor task
+    spsc_queue_t* checker_buf = ptr_args->checker_buf;  // Input queue from Sensor task
+    spsc_queue_t* monitor_buf = ptr_args->monitor_buf;  // Output queue to Monitor task
+    checker_stats_t* stats = ptr_args->stats;           // Transition counters
+    sensor_group_t* group = ptr_args->group;            // Channels in service
 
     // Variables
-    sensor_data_t* received_data;  // Pointer to data received from Sensor
-    sensor_data_t checker_data;    // Data to send to Monitor
-    size_t item_size;
+    sensor_frame_t received_frame;                                // Frame received from Sensor
+    sensor_frame_t checker_frame = {.source = DATA_SOURCE_CHECKER};  // Frame to send to Monitor
+    uint8_t pending_state = 0xFF;  // Candidate state awaiting confirmation
+    uint8_t pending_count = 0;     // Consecutive samples agreeing with the candidate
+    uint8_t active = atomic_load(&group->active);  // Channels in service
+    uint8_t drop_pending = 0;      // Outliers awaiting confirmation
+    uint8_t drop_count = 0;        // Consecutive samples with the same outliers
+    window_stats_t deviation_stats;  // Deviation over the last WINDOW_STATS_SIZE samples
+    window_summary_t window;
+    window_stats_reset(&deviation_stats);
+    window_stats_get(&deviation_stats, &window);
+    boot_ready(BOOT_READY_CHECKER);
 
     // Loop
     TASK_LOOP() {
-        // Wait to receive data from the Checker RingBuffer
-        received_data = (sensor_data_t*)xRingbufferReceive(*checker_buf, &item_size, portMAX_DELAY);
-        if (received_data != NULL && item_size == sizeof(sensor_data_t)) {
-            // Calculate deviation
-            //float deviation = fabsf(received_data->temperature1 - received_data->temperature2);
-            float deviation = fabsf(received_data->temperature1 - received_data->temperature2) / received_data->temperature1;
-
-            // Prepare data to send to Monitor
-            checker_data.source = DATA_SOURCE_CHECKER;
-            checker_data.temperature1 = received_data->temperature1;
-            checker_data.temperature2 = received_data->temperature2;
-            checker_data.deviation = deviation;
-
-            // Send the data to the Monitor RingBuffer
-            if (xRingbufferSend(*monitor_buf, &checker_data, sizeof(sensor_data_t), pdMS_TO_TICKS(100)) != pdTRUE) {
-                ESP_LOGW(TAG, "Monitor buffer full (Checker)");
+        // Wait to receive a frame from the Checker queue
+        if (spsc_queue_receive(checker_buf, &received_frame, portMAX_DELAY)) {
+            // The whole frame is checked in one wakeup
+            for (uint16_t k = 0; k < received_frame.count; k++) {
+                sensor_data_t* received_data = &received_frame.samples[k];
+                LATENCY_RECORD(LATENCY_CHECKER_IN, received_data->timestamp_us);
+
+                // Vote over the channels read that are still in service
+                uint8_t voters = active & sensor_data_channels(received_data);
+                uint8_t outliers;
+                float deviation;
+                uint8_t verdict = checker_vote(received_data, voters, &deviation, &outliers);
+
+                // The state follows the deviation statistics, never less severe than the vote
+                // (the state enum is ordered NORMAL_MODE < DEGRADED_MODE < ERROR)
+                if (__builtin_popcount(voters) >= 2) {
+                    window_stats_add(&deviation_stats, deviation);
+                    window_stats_get(&deviation_stats, &window);
+                }
+                // Compared with the system state, not with the last verdict posted: another
+                // task may have switched it (the Sensor degrades on missed deadlines), and the
+                // verdict is posted again to bring it back
+                uint8_t state = GET_ST_FROM_TASK();
+                uint8_t target = checker_classify(&window, state);
+                bool confirmed = target == ERROR;  // Already persisted over the whole window
+                if (verdict > target) {
+                    target = verdict;
+                }
+
+                // Drop the outlier channels once the same ones are confirmed
+                if (outliers != 0 && state != ERROR) {
+                    drop_count = (outliers == drop_pending) ? drop_count + 1 : 1;
+                    drop_pending = outliers;
+                    if (drop_count >= CHECKER_CONFIRM_SAMPLES) {
+                        active &= ~outliers;
+                        atomic_store(&group->active, active);
+                        stats->dropped += __builtin_popcount(outliers);
+                        DLOGW(TAG, "Channels 0x%02x dropped, 0x%02x in service", outliers, active);
+                        drop_pending = 0;
+                        drop_count = 0;
+                    }
+                } else {
+                    drop_pending = 0;
+                    drop_count = 0;
+                }
+
+                // Change state based on the vote, only once confirmed and only if it differs
+                if (state == ERROR || target == state) {
+                    pending_count = 0;
+                    stats->suppressed++;
+                } else {
+                    pending_count = (target == pending_state) ? pending_count + 1 : 1;
+                    pending_state = target;
+                    if (confirmed || pending_count >= CHECKER_CONFIRM_SAMPLES) {
+                        SWITCH_ST_FROM_TASK(target);
+                        DLOGD(TAG, "State %u posted (channels 0x%02x, deviation EWMA %.4f)", target, voters, window.ewma);
+                        pending_count = 0;
+                        stats->posted++;
+                        boot_mark(BOOT_PHASE_FIRST_VERDICT);
+                    } else {
+                        stats->suppressed++;
+                    }
+                }
+
+                // Prepare data to send to Monitor (same sample, Checker as source, channels in service)
+                sensor_data_t* checker_data = &checker_frame.samples[k];
+                *checker_data = *received_data;
+                checker_data->flags = SENSOR_FLAG_CHANNELS(active & sensor_data_channels(received_data)) | DATA_SOURCE_CHECKER;
             }
+            checker_frame.count = received_frame.count;
+            checker_frame.window = window;
 
-            // Change state based on deviation
-            if (deviation >= 0.20f) {
-                SWITCH_ST_FROM_TASK(ERROR);
-            } else if (deviation > 0.10f) {
-                SWITCH_ST_FROM_TASK(DEGRADED_MODE);
+            // Send the frame to the Monitor queue
+            if (!spsc_queue_send(monitor_buf, &checker_frame)) {
+                DLOGW(TAG, "Monitor buffer full (Checker)");
             } else {
-                SWITCH_ST_FROM_TASK(NORMAL_MODE);
+                for (uint16_t k = 0; k < checker_frame.count; k++) {
+                    LATENCY_RECORD(LATENCY_CHECKER_OUT, checker_frame.samples[k].timestamp_us);
+                }
             }
-
-            // Return the item to the Checker RingBuffer
-            vRingbufferReturnItem(*checker_buf, (void*)received_data);
+            checker_frame.seq++;
         } 
         
         else {
-            ESP_LOGW(TAG, "No data received in Checker or incorrect size");
+            DLOGW(TAG, "No data received in Checker");
         }
     }
 
@@ -7,7 +7,6 @@
 
 // FreeRTOS
 #include <freertos/FreeRTOS.h>
-#include <freertos/ringbuf.h>
 #include <freertos/semphr.h>
 
 // ESP
@@ -17,11 +16,57 @@
 #include <esp_timer.h>
 
 // Project includes
+#include "boot.h"
 #include "config.h"
 #include "data_structures.h"
+#include "dlog.h"
+#include "flashlog.h"
+#include "latency.h"
+#include "telemetry.h"
 
 static const char *TAG = "STF_P1:task_monitor";
 
+// Summary of the Sensor samples of one report interval (MONITOR_REPORT_INTERVAL_MS)
+typedef struct {
+    uint32_t count;
+    int64_t sum;    // Centi-degrees
+    int16_t min;
+    int16_t max;
+    uint8_t state;  // State the samples were reported in
+} monitor_summary_t;
+
+static void monitor_summary_add(monitor_summary_t *summary, int16_t cdeg, uint8_t state) {
+    if (summary->count == 0) {
+        summary->min = cdeg;
+        summary->max = cdeg;
+        summary->state = state;
+    }
+    summary->count++;
+    summary->sum += cdeg;
+    if (cdeg < summary->min) summary->min = cdeg;
+    if (cdeg > summary->max) summary->max = cdeg;
+}
+
+// Logs the summary, if it holds any sample, and starts a new one
+static void monitor_summary_report(monitor_summary_t *summary, const window_summary_t *window) {
+    if (summary->count == 0) {
+        return;
+    }
+    float mean = (float)summary->sum / summary->count * 0.01f;
+    float min = cdeg_to_celsius(summary->min);
+    float max = cdeg_to_celsius(summary->max);
+    if (summary->state == DEGRADED_MODE) {
+        // Confidence band: the extremes widened by the smoothed deviation
+        DLOGI(TAG, "DEGRADED_MODE: %lu samples, T = %.2f°C (%.2f - %.2f), band (%.2f - %.2f)°C",
+              (unsigned long)summary->count, mean, min, max, min - min * window->ewma, max + max * window->ewma);
+    } else {
+        DLOGI(TAG, "NORMAL_MODE: %lu samples, T = %.2f°C (%.2f - %.2f)",
+              (unsigned long)summary->count, mean, min, max);
+    }
+    summary->count = 0;
+    summary->sum = 0;
+}
+
 // Monitor Task
 SYSTEM_TASK(TASK_MONITOR) {
     TASK_BEGIN();
@@ -29,66 +74,162 @@ SYSTEM_TASK(TASK_MONITOR) {
 
     // Retrieve task arguments
     task_monitor_args_t *ptr_args = (task_monitor_args_t *)TASK_ARGS;
-    RingbufHandle_t *monitor_buf = ptr_args->monitor_buf;
+    spsc_queue_t *monitor_buf = ptr_args->monitor_buf;
+    spsc_queue_t *monitor_checker_buf = ptr_args->monitor_checker_buf;
+    pipeline_counters_t *counters = ptr_args->counters;
+    // Checker first so a new deviation applies to the samples that follow it
+    spsc_queue_t *queues[] = {monitor_checker_buf, monitor_buf};
 
     // Variables
-    size_t item_size;
-    sensor_data_t *received_data;
-    float last_deviation = 0.0f;
+    sensor_frame_t frame;
+    window_summary_t window = {0};  // Last deviation statistics from the Checker
+    uint8_t last_state = GET_ST_FROM_TASK();
+
+    // Last sequence number seen on each link, to detect drops and reordering
+    uint16_t last_seq[2] = {0, 0};
+    bool seq_valid[2] = {false, false};
+    uint32_t dropped = 0;
+    uint32_t reordered = 0;
+
+    // Wakeups against samples, to report the context switches saved by batching
+    uint32_t wakeups = 0;
+    uint32_t samples = 0;
+    int64_t t_report = esp_timer_get_time();
+
+    // Aggregated reporting (MONITOR_REPORT_INTERVAL_MS > 0)
+    monitor_summary_t summary = {0};
+    int64_t t_summary = t_report;
+    boot_ready(BOOT_READY_MONITOR);
 
     // Loop
     TASK_LOOP() {
-        // Wait to receive data from the ring buffer
-        received_data = (sensor_data_t *)xRingbufferReceive(*monitor_buf, &item_size, portMAX_DELAY);
+        // Wait until Sensor or Checker publish data
+        if (!spsc_queue_wait(queues, 2, portMAX_DELAY)) {
+            continue;
+        }
 
-        if (received_data != NULL && item_size == sizeof(sensor_data_t)) {
-            float deviation = received_data->deviation;
+        wakeups++;
+
+        // Drain both queues in a single wakeup
+        while (spsc_queue_pop(monitor_checker_buf, &frame) || spsc_queue_pop(monitor_buf, &frame)) {
+            samples += frame.count;
+            if (frame.source == DATA_SOURCE_SENSOR) {
+                counters->consumed += frame.count;
+            } else {
+                window = frame.window;
+                if (GET_ST_FROM_TASK() == DEGRADED_MODE && !TELEMETRY_ENABLE) {
+                    DLOGI(TAG, "Deviation: EWMA %.2f%%, mean %.2f%% sd %.2f%%, range %.2f-%.2f%% over %u samples",
+                          window.ewma * 100.0f, window.mean * 100.0f, sqrtf(window.variance) * 100.0f,
+                          window.min * 100.0f, window.max * 100.0f, window.count);
+                }
+            }
+
+            for (uint16_t k = 0; k < frame.count; k++) {
+                sensor_data_t *received_data = &frame.samples[k];
+                data_source_t source = sensor_data_source(received_data);
+                float temperature = cdeg_to_celsius(received_data->temperature[sensor_data_primary(received_data)]);
+                LATENCY_RECORD(source == DATA_SOURCE_SENSOR ? LATENCY_MONITOR_IN : LATENCY_MONITOR_CHK_IN,
+                               received_data->timestamp_us);
+
+                if (received_data->version != SENSOR_DATA_VERSION) {
+                    DLOGW(TAG, "Unknown record version %u", received_data->version);
+                    continue;
+                }
 
+                if (seq_valid[source]) {
+                    int16_t delta = sensor_seq_delta(last_seq[source], received_data->seq);
+                    if (delta > 1) {
+                        dropped += delta - 1;
+                    } else if (delta <= 0) {
+                        reordered++;
+                    }
+                }
+                last_seq[source] = received_data->seq;
+                seq_valid[source] = true;
+
+                // Binary telemetry and flash log: every record, and the state changes seen between them
+                uint8_t state = GET_ST_FROM_TASK();
+                if (state != last_state) {
+                    // A summary never mixes samples of two states
+                    monitor_summary_report(&summary, &window);
+                    TELEMETRY_STATE(received_data->timestamp_us, last_state, state);
+                    FLASHLOG_STATE_RECORD(last_state, state);
+                    last_state = state;
+                }
+                if (source == DATA_SOURCE_SENSOR) {
+                    TELEMETRY_SAMPLE(received_data);
+                    FLASHLOG_SAMPLE_RECORD(received_data);
+                } else {
+                    TELEMETRY_DEVIATION(received_data);
+                }
 
-            switch(GET_ST_FROM_TASK())
-                {
+                switch (state) {
                     case NORMAL_MODE:
-                        // Check the source of the data
-                        if (received_data->source == DATA_SOURCE_SENSOR) {
+                        // Check the source of the data (printed only without the binary telemetry)
+                        if (source == DATA_SOURCE_SENSOR && MONITOR_REPORT_INTERVAL_MS > 0) {
+                            monitor_summary_add(&summary, received_data->temperature[sensor_data_primary(received_data)], state);
+                        } else if (source == DATA_SOURCE_SENSOR && !TELEMETRY_ENABLE) {
                             // Data from Sensor task
-                        ESP_LOGI(TAG, "NORMAL_MODE: T = %.2f°C", received_data->temperature1);
-                        } 
-                        
-                        // else if (received_data->source == DATA_SOURCE_CHECKER) {
+                            DLOGI(TAG, "NORMAL_MODE: T = %.2f°C", temperature);
+                        }
+
+                        // else if (source == DATA_SOURCE_CHECKER) {
                         //     // Data from Checker task
-                        //     ESP_LOGI(TAG, "Checker Data: Deviation = %.2f%% between T1 = %.2f°C and T2 = %.2f°C",
-                        //             received_data->deviation, received_data->temperature1, received_data->temperature2);
+                        //     ESP_LOGI(TAG, "Checker Data: Deviation = %.2f%% over channels 0x%02x",
+                        //             sensor_data_deviation(received_data), sensor_data_channels(received_data));
                         // } else {
                         //     // Unknown source
                         //     ESP_LOGW(TAG, "Unknown data source");
                         // }
-                    break;
-
+                        break;
 
                     case DEGRADED_MODE:
-                        if (received_data->source == DATA_SOURCE_SENSOR) {
-                            float temp_min = received_data->temperature1 - (received_data->temperature1 * last_deviation);
-                            float temp_max = received_data->temperature1 + (received_data->temperature1 * last_deviation);
-                            ESP_LOGI(TAG, "DEGRADED_MODE: T = (%.2f - %.2f)°C", temp_min, temp_max);
-                        } else if (received_data->source == DATA_SOURCE_CHECKER) {
-                            last_deviation = deviation;
+                        if (source == DATA_SOURCE_SENSOR && MONITOR_REPORT_INTERVAL_MS > 0) {
+                            monitor_summary_add(&summary, received_data->temperature[sensor_data_primary(received_data)], state);
+                        } else if (source == DATA_SOURCE_SENSOR && !TELEMETRY_ENABLE) {
+                            // Band from the smoothed deviation, not from the last Checker sample
+                            float temp_min = temperature - (temperature * window.ewma);
+                            float temp_max = temperature + (temperature * window.ewma);
+                            DLOGI(TAG, "DEGRADED_MODE: T = (%.2f - %.2f)°C", temp_min, temp_max);
                         }
                         break;
-                    break;
 
                     case ERROR:
+                        monitor_summary_report(&summary, &window);
+                        // Last message before the pipeline stops: synchronous, not deferred
                         ESP_LOGI(TAG, "Sensor ERROR. Repare and restart.");
+                        // Keep the last samples on flash before stopping
+                        FLASHLOG_FLUSH();
                         TASK_END();
-                    break;
+                        break;
 
                     default:
-                        vTaskDelay(100);
+                        // No verdict from the Checker yet: the sample is not reported
+                        break;
                 }
-                // Return the item to the ring buffer
-                vRingbufferReturnItem(*monitor_buf, (void *)received_data);
 
-        } else {
-            ESP_LOGW(TAG, "No data received or incorrect size");
+                if (source == DATA_SOURCE_SENSOR) {
+                    LATENCY_RECORD(LATENCY_MONITOR_OUT, received_data->timestamp_us);
+                }
+            }
+        }
+
+        // One summary per interval, whatever the sample rate
+        int64_t now = esp_timer_get_time();
+        if (MONITOR_REPORT_INTERVAL_MS > 0 && now - t_summary >= MONITOR_REPORT_INTERVAL_MS * 1000LL) {
+            monitor_summary_report(&summary, &window);
+            t_summary = now;
+        }
+
+        // Every sample beyond the first in a wakeup saves a switch into and out of Monitor
+        if (now - t_report >= BATCH_REPORT_PERIOD_MS * 1000LL) {
+            DLOGI(TAG, "Batching: %lu samples in %lu wakeups, %lu context switches/s saved (%lu dropped, %lu reordered)",
+                     (unsigned long)samples, (unsigned long)wakeups,
+                     (unsigned long)(samples > wakeups ? 2 * (uint64_t)(samples - wakeups) * 1000000 / (now - t_report) : 0),
+                     (unsigned long)dropped, (unsigned long)reordered);
+            wakeups = 0;
+            samples = 0;
+            t_report = now;
         }
     }
 
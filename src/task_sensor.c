@@ -5,25 +5,154 @@
 #include <esp_system.h>
 #include <esp_timer.h>
 #include <freertos/FreeRTOS.h>
-#include <freertos/semphr.h>
 #include <math.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/time.h>
 #include <time.h>
 
+#include "boot.h"
 #include "config.h"
 #include "data_structures.h"
+#include "deadline.h"
+#include "dlog.h"
+#include "filter.h"
+#include "latency.h"
+#include "sample_clock.h"
 #include "therm.h"
 
 static const char *TAG = "STF_P1:task_sensor";
 
-// Semaphore for timer expiration
-static SemaphoreHandle_t semSample = NULL;
+// Sample period deadlines (static: the Stats task keeps reading it if the Sensor stops)
+static deadline_monitor_t sensor_deadline;
 
-// Timer callback function
-static void tmrSampleCallback(void *arg) {
-    xSemaphoreGive(semSample);
+// Frame being filled for one output link
+typedef struct {
+    sensor_frame_t frame;
+    int64_t t_first_us;  // Time of the first sample in the frame
+} frame_builder_t;
+
+// Appends a sample and publishes the frame when it is full, or when holding it one
+// more period (of this link) would exceed the flush deadline
+static void frame_append(spsc_queue_t *queue, frame_builder_t *fb, const sensor_data_t *sample,
+                         uint32_t period_us, const char *name) {
+    int64_t now = esp_timer_get_time();
+    if (fb->frame.count == 0) {
+        fb->t_first_us = now;
+    }
+    fb->frame.samples[fb->frame.count++] = *sample;
+
+    if (fb->frame.count == SENSOR_BATCH_SIZE ||
+        now - fb->t_first_us + period_us >= SENSOR_BATCH_FLUSH_MS * 1000) {
+        if (!spsc_queue_send(queue, &fb->frame)) {
+            DLOGW(TAG, "%s buffer full", name);
+        } else {
+            DLOGD(TAG, "Sent %u samples to %s", fb->frame.count, name);
+            for (uint16_t k = 0; k < fb->frame.count; k++) {
+                LATENCY_RECORD(LATENCY_SENSOR_SEND, fb->frame.samples[k].timestamp_us);
+            }
+        }
+        fb->frame.seq++;
+        fb->frame.count = 0;
+    }
+}
+
+// Timing derived from the sample period in force, recomputed when it changes
+typedef struct {
+    uint32_t period_us;              // Sample period
+    uint32_t checker_every;          // Periods between Checker reads
+    uint32_t settle_margin_us;       // Time after settling before a reading is valid
+    uint32_t lead[SENSOR_CHANNELS];  // Periods ahead of the Checker read to power each channel on
+#if THERM_ADC_MODE == THERM_ADC_MODE_CONTINUOUS
+    uint32_t frames;                 // DMA frames averaged into one sample
+#else
+    TickType_t timeout_ticks;        // Soft watchdog: a missed period (see deadline.h)
+#endif
+} sensor_timing_t;
+
+static void sensor_timing_update(sensor_timing_t *t, uint32_t period_us, uint32_t checker_interval_us,
+                                 const therm_t *therms) {
+#if THERM_ADC_MODE == THERM_ADC_MODE_CONTINUOUS
+    // The period is a whole number of DMA frames, averaged into one sample
+    uint32_t frame_us = ((uint64_t)THERM_CONT_FRAME_CONVERSIONS * 1000000) / THERM_CONT_SAMPLE_FREQ_HZ;
+    t->frames = (period_us + frame_us / 2) / frame_us;
+    if (t->frames == 0) {
+        t->frames = 1;
+    }
+    t->period_us = t->frames * frame_us;
+    // A reading is valid only if every averaged frame was converted after the channel settled
+    t->settle_margin_us = t->period_us;
+#else
+    t->period_us = period_us;
+    // The conversion happens at read time
+    t->settle_margin_us = 0;
+    // Soft watchdog: 20% over the period, and at least one tick more
+    t->timeout_ticks = pdMS_TO_TICKS((uint64_t)period_us * 12 / 10 / 1000) + 1;
+#endif
+
+    // The Checker keeps its interval in time: in periods it scales with the rate
+    t->checker_every = (checker_interval_us + t->period_us / 2) / t->period_us;
+    if (t->checker_every == 0) {
+        t->checker_every = 1;
+    }
+
+    // Each secondary channel is switched on lead[c] periods before the Checker read, enough
+    // to cover its settle time, so the loop never sleeps on it. Channels that need every
+    // period between reads or more stay powered
+    for (uint8_t c = 0; c < SENSOR_CHANNELS; c++) {
+        uint32_t lead = ((uint64_t)therms[c].settle_us + t->settle_margin_us + t->period_us - 1) / t->period_us;
+        t->lead[c] = lead < 1 ? 1 : (lead > t->checker_every ? t->checker_every : lead);
+    }
+}
+
+// Hardware watchdog on the loop while one wait fits in the TWDT timeout
+static void sensor_watchdog_update(system_task_t *task, const sensor_timing_t *t) {
+#if DEADLINE_TASK_WDT
+#if THERM_ADC_MODE == THERM_ADC_MODE_CONTINUOUS
+    // One DMA frame per iteration, whatever the sample period
+    bool fits = SYSTEM_TASK_WDT_TIMEOUT_US > 0;
+#elif CONFIG_ESP_TASK_WDT_EN
+    bool fits = (uint64_t)t->timeout_ticks * portTICK_PERIOD_MS * 1000 < SYSTEM_TASK_WDT_TIMEOUT_US;
+#else
+    bool fits = false;
+#endif
+    if (fits != task->sys_task_wdt && system_task_watchdog(task, fits) == ESP_OK) {
+        DLOGI(TAG, "Task watchdog %s", fits ? "on" : "off (period too long)");
+    }
+#endif
+}
+
+// Applies the escalation stage reached by a run of late or missed periods
+static void sensor_deadline_escalate(system_task_t *task, const deadline_monitor_t *dm, deadline_stage_t stage) {
+    switch (stage) {
+        case DEADLINE_LOG:
+            DLOGW(TAG, "Deadline: %lu periods late or missed (%lu late, %lu missed, worst overrun %lu us)",
+                  (unsigned long)dm->consecutive, (unsigned long)dm->late, (unsigned long)dm->missed,
+                  (unsigned long)dm->worst_overrun_us);
+            break;
+        case DEADLINE_DEGRADE:
+            // Never over ERROR, nor before the Checker has posted a first state
+            // The Checker compares its verdict with this state and posts it back once confirmed
+            if (task->system->sys_state == NORMAL_MODE) {
+                DLOGW(TAG, "Deadline: %lu periods late or missed, switching to DEGRADED_MODE",
+                      (unsigned long)dm->consecutive);
+                system_switch_state(task->system, DEGRADED_MODE);
+            }
+            break;
+        case DEADLINE_RESTART:
+            // Synchronous log: the deferred one would be lost in the restart
+            ESP_LOGE(TAG, "Deadline: %lu periods late or missed in a row, restarting", (unsigned long)dm->consecutive);
+            esp_restart();
+            break;
+        default:
+            break;
+    }
+}
+
+// Powers a channel on; its filter restarts, readings from before the power cycle no longer apply
+static void channel_power_on(therm_t therm, filter_t *filter) {
+    therm_power_on(therm);
+    filter_reset(filter);
 }
 
 // Sensor Task
@@ -33,113 +162,242 @@ SYSTEM_TASK(TASK_SENSOR) {
 
     // Retrieve task arguments
     task_sensor_args_t *ptr_args = (task_sensor_args_t *)TASK_ARGS;
-    RingbufHandle_t *monitor_buf = ptr_args->monitor_buf;
-    RingbufHandle_t *checker_buf = ptr_args->checker_buf;
-    uint8_t frequency = ptr_args->freq;
-    uint64_t period_us = 1000000 / frequency;
-    uint8_t N = ptr_args->checker_period;
-
-    // Thermistor configuration
-    therm_t t1;
-    ESP_ERROR_CHECK(therm_init(&t1, ADC_CHANNEL_6, THERM1_POWER_GPIO,
-                               SERIES_RESISTANCE, NOMINAL_RESISTANCE,
-                               NOMINAL_TEMPERATURE, BETA_COEFFICIENT));
-    therm_t t2;
-    ESP_ERROR_CHECK(therm_init(&t2, ADC_CHANNEL_7, THERM2_POWER_GPIO,
-                               SERIES_RESISTANCE, NOMINAL_RESISTANCE,
-                               NOMINAL_TEMPERATURE, BETA_COEFFICIENT));
-
-    // Initialize semaphore
-    semSample = xSemaphoreCreateBinary();
-    if (semSample == NULL) {
-        ESP_LOGE(TAG, "Failed to create semaphore");
-        TASK_END();
-        return;
+    spsc_queue_t *monitor_buf = ptr_args->monitor_buf;
+    spsc_queue_t *checker_buf = ptr_args->checker_buf;
+    sensor_rate_t *rate = ptr_args->rate;
+    uint32_t checker_interval_us = ptr_args->checker_interval_us;
+    pipeline_counters_t *counters = ptr_args->counters;
+    sensor_group_t *group = ptr_args->group;
+    void (*period_changed)(uint32_t) = ptr_args->period_changed;
+
+    // Thermistor group configuration
+    const adc_channel_t adc_channels[SENSOR_CHANNELS] = SENSOR_CHANNEL_ADC;
+    const gpio_num_t power_gpios[SENSOR_CHANNELS] = SENSOR_CHANNEL_POWER_GPIO;
+    const uint32_t settle_us[SENSOR_CHANNELS] = SENSOR_CHANNEL_SETTLE_US;
+    therm_t therms[SENSOR_CHANNELS];
+    filter_t filters[SENSOR_CHANNELS];
+    for (uint8_t c = 0; c < SENSOR_CHANNELS; c++) {
+        ESP_ERROR_CHECK(therm_init(&therms[c], adc_channels[c], power_gpios[c],
+                                   SERIES_RESISTANCE, NOMINAL_RESISTANCE,
+                                   NOMINAL_TEMPERATURE, BETA_COEFFICIENT));
+        therms[c].settle_us = settle_us[c];
     }
 
-    // Timer configuration
-    const esp_timer_create_args_t tmrSampleArgs = {
-        .callback = &tmrSampleCallback,
-        .name = "Sample Timer"};
+    // Sample period in force (see sensor_rate.h)
+    uint32_t requested_us = atomic_load(&rate->period_us);
+    sensor_timing_t timing;
+    sensor_timing_update(&timing, requested_us, checker_interval_us, therms);
+    ESP_LOGI(TAG, "Sample period %lu us, Checker every %lu periods",
+             (unsigned long)timing.period_us, (unsigned long)timing.checker_every);
+    // Deadline of each sample: the end of its period
+    deadline_init(&sensor_deadline, "sensor", timing.period_us);
 
-    // Create and start the timer
-    esp_timer_handle_t tmrSample;
-    ESP_ERROR_CHECK(esp_timer_create(&tmrSampleArgs, &tmrSample));
-    ESP_ERROR_CHECK(esp_timer_start_periodic(tmrSample, period_us));
+#if THERM_ADC_MODE == THERM_ADC_MODE_CONTINUOUS
+    // Continuous mode: the DMA frames pace the loop, no sample timer needed
+    uint16_t lsb[SENSOR_CHANNELS];
+    uint32_t lsb_sum[SENSOR_CHANNELS] = {0};  // Frames accumulated for the current sample
+    uint16_t q4[SENSOR_CHANNELS];             // Average of the frames, Q4
+    uint32_t frames = 0;
+    uint32_t frame_timeout_ms = ((THERM_CONT_FRAME_CONVERSIONS * 1000) / THERM_CONT_SAMPLE_FREQ_HZ) * 1.2 + portTICK_PERIOD_MS;
+    ESP_ERROR_CHECK(therm_continuous_start(therms, SENSOR_CHANNELS, THERM_CONT_SAMPLE_FREQ_HZ, THERM_CONT_FRAME_CONVERSIONS));
+    ESP_LOGI(TAG, "Continuous acquisition at %d Hz, %d conversions per frame",
+             THERM_CONT_SAMPLE_FREQ_HZ, THERM_CONT_FRAME_CONVERSIONS);
+#else
+    // Sample clock: every tick notifies this task directly
+    ESP_ERROR_CHECK(sample_clock_start(timing.period_us));
+#endif
 
     // Variables
     uint32_t i = 0;
-    float temperature1, temperature2;
-    size_t data_size = sizeof(sensor_data_t);
+    float temperature;
+    uint32_t timestamp_us;
+    uint16_t monitor_seq = 0;
+    uint16_t checker_seq = 0;
+    frame_builder_t monitor_frame = {.frame.source = DATA_SOURCE_SENSOR};
+    frame_builder_t checker_frame = {.frame.source = DATA_SOURCE_SENSOR};
 
-    // Power on T1 once at the beginning
-    therm_power_on(t1);
-    ESP_LOGI(TAG, "T1 powered on");
+    // Power scheduling of the other channels (see sensor_timing_t)
+    int64_t ready_us[SENSOR_CHANNELS] = {0};  // Time from which a reading is valid, 0 while off
+    bool checker_due = false;                 // A Checker read is due (deferred while settling)
+
+    // Power on the primary channel once at the beginning
+    uint8_t active = atomic_load(&group->active);
+    uint8_t primary = __builtin_ctz(active);
+    channel_power_on(therms[primary], &filters[primary]);
+    ESP_LOGI(TAG, "T%u powered on (primary)", primary + 1);
+    // ADC, sample clock and primary channel up
+    boot_ready(BOOT_READY_SENSOR);
+    sensor_watchdog_update(__task, &timing);
 
     // Loop
     TASK_LOOP() {
-        // Wait for semaphore with a calculated timeout
-        TickType_t timeout_ticks = ((1000 / frequency) * 1.2) / portTICK_PERIOD_MS;
-        if (xSemaphoreTake(semSample, timeout_ticks)) {
-            // Read T1 temperature (T1 is already powered on)
-            temperature1 = therm_read_temperature(t1);
-            ESP_LOGD(TAG, "Read T1: %.2f°C", temperature1);
+#if THERM_ADC_MODE == THERM_ADC_MODE_CONTINUOUS
+        // Wait for a whole DMA frame (every channel averaged over the frame)
+        if (therm_continuous_read(lsb, SENSOR_CHANNELS, frame_timeout_ms) == ESP_OK) {
+            // One sample every timing.frames frames, averaged
+            for (uint8_t c = 0; c < SENSOR_CHANNELS; c++) {
+                lsb_sum[c] += lsb[c];
+            }
+            if (++frames < timing.frames) {
+                continue;
+            }
+            for (uint8_t c = 0; c < SENSOR_CHANNELS; c++) {
+                q4[c] = (((uint64_t)lsb_sum[c] << FILTER_Q) + frames / 2) / frames;
+                lsb_sum[c] = 0;
+            }
+            frames = 0;
+
+            // The last frame is complete when the read returns: that is the sampling tick
+            timestamp_us = (uint32_t)esp_timer_get_time();
+            temperature = therm_lsb_to_temperature(therms[primary], filter_update(&filters[primary], q4[primary]));
+#else
+        // Wait for the next sample clock tick (its time is the sample timestamp)
+        if (sample_clock_wait(timing.timeout_ticks, &timestamp_us)) {
+            // Read the primary channel (it is already powered on)
+            temperature = therm_lsb_to_temperature(therms[primary], filter_read(&filters[primary], therms[primary]));
+#endif
+            LATENCY_RECORD(LATENCY_SENSOR_READ, timestamp_us);
+            DLOGD(TAG, "Read T%u: %.2f°C", primary + 1, temperature);
 
             // Prepare data for Monitor task
             sensor_data_t monitor_data = {
-                .source = DATA_SOURCE_SENSOR,
-                .temperature1 = temperature1,
-                .temperature2 = 0.0f,
-                .deviation = 0.0f};
+                .timestamp_us = timestamp_us,
+                .seq = monitor_seq++,
+                .version = SENSOR_DATA_VERSION,
+                .flags = DATA_SOURCE_SENSOR | SENSOR_FLAG_CHANNELS(1u << primary)};
+            monitor_data.temperature[primary] = celsius_to_cdeg(temperature);
 
             // Send to Monitor task
-            if (xRingbufferSend(*monitor_buf, &monitor_data, data_size, pdMS_TO_TICKS(100)) != pdTRUE) {
-                ESP_LOGW(TAG, "Monitor buffer full");
-            } else {
-                ESP_LOGD(TAG, "Sent data to Monitor: T1 = %.2f°C", temperature1);
-            }
+            frame_append(monitor_buf, &monitor_frame, &monitor_data, timing.period_us, "Monitor");
+            counters->produced++;
 
             i++;
+            if (i == 1) {
+                boot_mark(BOOT_PHASE_FIRST_SAMPLE);
+            }
+
+            // Periods until the next Checker read (0: this one)
+            uint32_t N = timing.checker_every;
+            uint32_t until = (N - i % N) % N;
+            checker_due = checker_due || until == 0;
+            int64_t now = esp_timer_get_time();
+            uint8_t secondary = active & ~(1u << primary);
+
+            // Switch the other channels on ahead of the read
+            for (uint8_t c = 0; c < SENSOR_CHANNELS; c++) {
+                if ((secondary & (1u << c)) && ready_us[c] == 0 && (checker_due || until <= timing.lead[c])) {
+                    ready_us[c] = therm_power_on_async(therms[c]) + timing.settle_margin_us;
+                    filter_reset(&filters[c]);
+                }
+            }
+
+            // Every N periods, read every channel in service in one pass and send data to Checker task
+            if (checker_due) {
+                bool settled = true;
+                for (uint8_t c = 0; c < SENSOR_CHANNELS; c++) {
+                    if ((secondary & (1u << c)) && now < ready_us[c]) {
+                        settled = false;
+                    }
+                }
 
-            // Every N periods, read T2 and send data to Checker task
-            if (i % N == 0) {
-                // Power on T2
-                therm_power_on(t2);
-                ESP_LOGD(TAG, "T2 powered on");
-
-                // Read T2 temperature
-                temperature2 = therm_read_temperature(t2);
-                ESP_LOGD(TAG, "Read T2: %.2f°C", temperature2);
-
-                // Power off T2 after reading
-                therm_power_off(t2);
-                ESP_LOGD(TAG, "T2 powered off");
-
-                // Prepare data for Checker task
-                sensor_data_t checker_data = {
-                    .source = DATA_SOURCE_SENSOR,  // Indicates data from Sensor task
-                    .temperature1 = temperature1,
-                    .temperature2 = temperature2,
-                    .deviation = 0.0f  // To be calculated by Checker task
-                };
-
-                // Send to Checker task
-                if (xRingbufferSend(*checker_buf, &checker_data, data_size, pdMS_TO_TICKS(100)) != pdTRUE) {
-                    ESP_LOGW(TAG, "Checker buffer full");
+                if (!settled) {
+                    // Only if a settle deadline was missed: try again next period
+                    DLOGD(TAG, "Channels still settling, Checker read deferred");
                 } else {
-                    ESP_LOGD(TAG, "Sent data to Checker: T1 = %.2f°C, T2 = %.2f°C", temperature1, temperature2);
+                    checker_due = false;
+
+                    // Prepare data for Checker task
+                    sensor_data_t checker_data = {
+                        .timestamp_us = timestamp_us,
+                        .seq = checker_seq++,
+                        .version = SENSOR_DATA_VERSION,
+                        .flags = DATA_SOURCE_SENSOR | SENSOR_FLAG_CHANNELS(active)};  // Indicates data from Sensor task
+
+                    for (uint8_t c = 0; c < SENSOR_CHANNELS; c++) {
+                        if (c == primary) {
+                            // The primary channel was filtered and read this period already
+                            checker_data.temperature[c] = monitor_data.temperature[c];
+                        } else if (secondary & (1u << c)) {
+#if THERM_ADC_MODE == THERM_ADC_MODE_CONTINUOUS
+                            // Same frames as the primary channel: converted after the channel settled
+                            uint16_t filtered = filter_update(&filters[c], q4[c]);
+#else
+                            uint16_t filtered = filter_read(&filters[c], therms[c]);
+#endif
+                            checker_data.temperature[c] = celsius_to_cdeg(therm_lsb_to_temperature(therms[c], filtered));
+
+                            // Power off the channel after reading, unless it stays powered
+                            if (timing.lead[c] < N) {
+                                therm_power_off(therms[c]);
+                                ready_us[c] = 0;
+                            }
+                        }
+                    }
+                    DLOGD(TAG, "Read %u channels", __builtin_popcount(active));
+
+                    // Send to Checker task (this link carries one sample every N periods)
+                    frame_append(checker_buf, &checker_frame, &checker_data, timing.period_us * N, "Checker");
+                }
+            }
+
+            // Follow the channels dropped by the Checker: a dropped primary hands over to the next one
+            uint8_t in_service = atomic_load_explicit(&group->active, memory_order_relaxed);
+            if (in_service != active && in_service != 0) {
+                // Dropped channels are no longer powered
+                for (uint8_t c = 0; c < SENSOR_CHANNELS; c++) {
+                    if (!(in_service & (1u << c)) && ready_us[c] != 0) {
+                        therm_power_off(therms[c]);
+                        ready_us[c] = 0;
+                    }
+                }
+                active = in_service;
+                if (!(active & (1u << primary))) {
+                    therm_power_off(therms[primary]);
+                    primary = __builtin_ctz(active);
+                    // Rare: the new primary may still have to settle here if it was off
+                    if (ready_us[primary] == 0) {
+                        channel_power_on(therms[primary], &filters[primary]);
+                    } else {
+                        filter_reset(&filters[primary]);
+                    }
+                    ready_us[primary] = 0;
+                    DLOGW(TAG, "T%u is now the primary channel", primary + 1);
+                }
+            }
+
+            // Done with this period: time from the sampling tick to here
+            uint32_t response_us = (uint32_t)esp_timer_get_time() - timestamp_us;
+            sensor_deadline_escalate(__task, &sensor_deadline, deadline_complete(&sensor_deadline, response_us));
+
+            // Apply a new sample period from the next one on, without stopping
+            uint32_t period_us = atomic_load_explicit(&rate->period_us, memory_order_relaxed);
+            if (period_us != requested_us) {
+                requested_us = period_us;
+                sensor_timing_update(&timing, requested_us, checker_interval_us, therms);
+#if THERM_ADC_MODE == THERM_ADC_MODE_ONESHOT
+                ESP_ERROR_CHECK_WITHOUT_ABORT(sample_clock_set_period(timing.period_us));
+#endif
+                deadline_set(&sensor_deadline, timing.period_us);
+                sensor_watchdog_update(__task, &timing);
+                DLOGI(TAG, "Sample period %lu us, Checker every %lu periods",
+                      (unsigned long)timing.period_us, (unsigned long)timing.checker_every);
+                if (period_changed != NULL) {
+                    period_changed(timing.period_us);
                 }
             }
         } else {
-            ESP_LOGI(TAG, "Watchdog (soft) failed");
-            esp_restart();
+            // Soft watchdog: no tick (or DMA frame) in time. Escalates instead of restarting at once
+            sensor_deadline_escalate(__task, &sensor_deadline, deadline_miss(&sensor_deadline));
         }
     }
 
     ESP_LOGI(TAG, "Stopping Sensor task...");
     // Clean up
-    ESP_ERROR_CHECK(esp_timer_stop(tmrSample));
-    ESP_ERROR_CHECK(esp_timer_delete(tmrSample));
-    therm_power_off(t1);  // Ensure T1 is powered off when task ends
+#if THERM_ADC_MODE == THERM_ADC_MODE_CONTINUOUS
+    ESP_ERROR_CHECK(therm_continuous_stop());
+#else
+    ESP_ERROR_CHECK(sample_clock_stop());
+#endif
+    therm_power_off(therms[primary]);  // Ensure the primary channel is powered off when task ends
     TASK_END();
 }
\ No newline at end of file
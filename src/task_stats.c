@@ -0,0 +1,192 @@
+// task_stats.c
+
+#include <esp_log.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <stdio.h>
+
+#include "boot.h"
+#include "config.h"
+#include "deadline.h"
+#include "latency.h"
+#include "sample_clock.h"
+#include "spsc_queue.h"
+#include "system.h"
+#include "telemetry.h"
+
+static const char *TAG = "STF_P1:task_stats";
+
+// Size of the report line
+#define STATS_LINE_SIZE 512
+
+// Appends to the report line, never past its end
+#define STATS_APPEND(line, len, ...)                                             \
+    do {                                                                         \
+        if ((len) < STATS_LINE_SIZE) {                                           \
+            (len) += snprintf(&(line)[len], STATS_LINE_SIZE - (len), __VA_ARGS__); \
+        }                                                                        \
+    } while (0)
+
+// Stats Task
+SYSTEM_TASK(TASK_STATS) {
+    TASK_BEGIN();
+    ESP_LOGI(TAG, "Task Stats running");
+
+    // Retrieve task arguments
+    task_stats_args_t *ptr_args = (task_stats_args_t *)TASK_ARGS;
+
+    // Previous values, to report rates over the last period
+    int64_t last_time = esp_timer_get_time();
+#if STATS_COUNTERS & STATS_RATE
+    uint32_t last_produced = ptr_args->counters->produced;
+    uint32_t last_consumed = ptr_args->counters->consumed;
+#endif
+#if (STATS_COUNTERS & STATS_CPU) && configGENERATE_RUN_TIME_STATS
+    configRUN_TIME_COUNTER_TYPE last_runtime[STATS_MAX_TASKS] = {0};
+#endif
+    // Task names, kept to report the tasks that ERROR stops (their handles become NULL)
+    char names[STATS_MAX_TASKS][configMAX_TASK_NAME_LEN];
+    for (size_t t = 0; t < ptr_args->ntasks; t++) {
+        TaskHandle_t handle = system_task_handle_take(ptr_args->tasks[t]);
+        snprintf(names[t], sizeof(names[t]), "%s", handle != NULL ? pcTaskGetName(handle) : "?");
+#if (STATS_COUNTERS & STATS_CPU) && configGENERATE_RUN_TIME_STATS
+        if (handle != NULL) {
+            last_runtime[t] = ulTaskGetRunTimeCounter(handle);
+        }
+#endif
+        system_task_handle_give();
+    }
+
+    char line[STATS_LINE_SIZE];
+    boot_ready(BOOT_READY_STATS);
+
+    // Loop
+    TASK_LOOP() {
+        vTaskDelay(pdMS_TO_TICKS(STATS_PERIOD_MS));
+
+        int64_t now = esp_timer_get_time();
+        int64_t elapsed_us = now - last_time;
+        size_t len = 0;
+        last_time = now;
+        if (elapsed_us <= 0) {
+            continue;
+        }
+
+#if (STATS_COUNTERS & STATS_CPU) && configGENERATE_RUN_TIME_STATS
+        // Share of its core used by each task (the run time counter runs on esp_timer, in us)
+        STATS_APPEND(line, len, "cpu%%");
+        for (size_t t = 0; t < ptr_args->ntasks; t++) {
+            TaskHandle_t handle = system_task_handle_take(ptr_args->tasks[t]);
+            if (handle == NULL) {
+                system_task_handle_give();
+                STATS_APPEND(line, len, " %s=stopped", names[t]);
+                continue;
+            }
+            configRUN_TIME_COUNTER_TYPE runtime = ulTaskGetRunTimeCounter(handle);
+            system_task_handle_give();
+            uint32_t permille = (uint64_t)(runtime - last_runtime[t]) * 1000 / elapsed_us;
+            last_runtime[t] = runtime;
+            STATS_APPEND(line, len, " %s=%lu.%lu", names[t], (unsigned long)(permille / 10),
+                         (unsigned long)(permille % 10));
+        }
+        STATS_APPEND(line, len, " |");
+#endif
+
+#if STATS_COUNTERS & STATS_STACK
+        // Minimum free stack ever, in bytes
+        STATS_APPEND(line, len, " stk");
+        for (size_t t = 0; t < ptr_args->ntasks; t++) {
+            TaskHandle_t handle = system_task_handle_take(ptr_args->tasks[t]);
+            if (handle == NULL) {
+                system_task_handle_give();
+                STATS_APPEND(line, len, " %s=stopped", names[t]);
+                continue;
+            }
+            unsigned stack_free = (unsigned)uxTaskGetStackHighWaterMark(handle);
+            system_task_handle_give();
+            STATS_APPEND(line, len, " %s=%u", names[t], stack_free);
+        }
+        STATS_APPEND(line, len, " |");
+#endif
+
+#if STATS_COUNTERS & STATS_QUEUE
+        // Queue occupancy and rejected sends
+        STATS_APPEND(line, len, " q");
+        for (size_t q = 0; q < ptr_args->nqueues; q++) {
+            spsc_queue_t *queue = ptr_args->queues[q];
+            STATS_APPEND(line, len, " %s=%lu/%lu,d%lu", ptr_args->queue_names[q],
+                         (unsigned long)spsc_queue_count(queue), (unsigned long)spsc_queue_capacity(queue),
+                         (unsigned long)queue->drops);
+        }
+        STATS_APPEND(line, len, " |");
+#endif
+
+#if STATS_COUNTERS & STATS_RATE
+        // Samples per second through the pipeline
+        uint32_t produced = ptr_args->counters->produced;
+        uint32_t consumed = ptr_args->counters->consumed;
+        STATS_APPEND(line, len, " smp/s in=%lu out=%lu",
+                     (unsigned long)((uint64_t)(produced - last_produced) * 1000000 / elapsed_us),
+                     (unsigned long)((uint64_t)(consumed - last_consumed) * 1000000 / elapsed_us));
+        last_produced = produced;
+        last_consumed = consumed;
+        if (ptr_args->checker != NULL) {
+            STATS_APPEND(line, len, " st=%lu/%lu drop=%lu", (unsigned long)ptr_args->checker->posted,
+                         (unsigned long)ptr_args->checker->suppressed, (unsigned long)ptr_args->checker->dropped);
+        }
+        STATS_APPEND(line, len, " |");
+#endif
+
+#if (STATS_COUNTERS & STATS_CLOCK) && THERM_ADC_MODE == THERM_ADC_MODE_ONESHOT
+        // Interval between Sensor wakeups over the last period
+        sample_clock_jitter_t jitter;
+        sample_clock_jitter(&jitter, true);
+        STATS_APPEND(line, len, " clk n=%lu min=%lu max=%lu sd=%.1f wake=%lu missed=%lu |",
+                     (unsigned long)jitter.intervals, (unsigned long)jitter.min_us, (unsigned long)jitter.max_us,
+                     jitter.stddev_us, (unsigned long)jitter.max_wake_us, (unsigned long)jitter.missed);
+#endif
+
+#if STATS_COUNTERS & STATS_DEADLINE
+        // Periods completed, late and missed, and the worst overrun since boot
+        STATS_APPEND(line, len, " dl");
+        for (size_t d = 0; d < deadline_count(); d++) {
+            const deadline_monitor_t *dm = deadline_get(d);
+            STATS_APPEND(line, len, " %s=%lu,l%lu,m%lu,w%lu", dm->name, (unsigned long)dm->activations,
+                         (unsigned long)dm->late, (unsigned long)dm->missed, (unsigned long)dm->worst_overrun_us);
+        }
+        STATS_APPEND(line, len, " |");
+#endif
+
+        STATS_APPEND(line, len, " heap=%lu", (unsigned long)esp_get_free_heap_size());
+        ESP_LOGI(TAG, "%s", line);
+
+        // Sample latency per pipeline stage, since boot
+        LATENCY_DUMP();
+
+#if TELEMETRY_ENABLE
+        // Same counters on the binary stream, accumulated since boot
+        telemetry_stats_t telemetry = {
+            .uptime_ms = now / 1000,
+            .produced = ptr_args->counters->produced,
+            .consumed = ptr_args->counters->consumed,
+        };
+        for (size_t q = 0; q < ptr_args->nqueues; q++) {
+            telemetry.queue_drops += ptr_args->queues[q]->drops;
+        }
+        if (ptr_args->checker != NULL) {
+            telemetry.posted = ptr_args->checker->posted;
+            telemetry.suppressed = ptr_args->checker->suppressed;
+            telemetry.dropped = ptr_args->checker->dropped;
+        }
+        if (ptr_args->group != NULL) {
+            telemetry.active = atomic_load_explicit(&ptr_args->group->active, memory_order_relaxed);
+        }
+        TELEMETRY_STATS(&telemetry);
+#endif
+    }
+
+    ESP_LOGI(TAG, "Stopping Stats task...");
+    TASK_END();
+}
@@ -0,0 +1,172 @@
+// telemetry.c
+
+#include "telemetry.h"
+
+#include <string.h>
+
+size_t telemetry_cobs_encode(const uint8_t *in, size_t len, uint8_t *out) {
+    size_t code_pos = 0;  // Byte de código del bloque en curso
+    size_t o = 1;
+    uint8_t code = 1;     // Distancia hasta el siguiente cero (o fin de bloque)
+    for (size_t i = 0; i < len; i++) {
+        if (in[i] != 0) {
+            out[o++] = in[i];
+            code++;
+        }
+        // Un cero cierra el bloque; un bloque de 254 bytes sin ceros también
+        if (in[i] == 0 || code == 0xFF) {
+            out[code_pos] = code;
+            code_pos = o++;
+            code = 1;
+        }
+    }
+    out[code_pos] = code;
+    out[o++] = 0x00;
+    return o;
+}
+
+uint16_t telemetry_crc16(const uint8_t *data, size_t len) {
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; b++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+#if TELEMETRY_ENABLE
+
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#if CONFIG_IDF_TARGET_LINUX
+#include <stdio.h>
+#else
+#include <driver/uart.h>
+#endif
+
+static const char *TAG = "STF_P1:telemetry";
+
+_Static_assert(2 + 9 + 2 * SENSOR_CHANNELS + 2 <= TELEMETRY_RECORD_MAX, "DEVIATION record does not fit");
+
+#if CONFIG_IDF_TARGET_LINUX
+static FILE *telemetry_file = NULL;
+#endif
+
+// Contador de registros, compartido por todas las tareas que envían. Se asigna y el
+// registro se escribe bajo el mismo mutex, así que los registros salen en orden de
+// contador y un salto en el receptor es siempre una pérdida
+static uint8_t telemetry_counter = 0;
+static SemaphoreHandle_t telemetry_mutex = NULL;
+static StaticSemaphore_t telemetry_mutex_buffer;
+
+esp_err_t telemetry_init(void) {
+    telemetry_mutex = xSemaphoreCreateMutexStatic(&telemetry_mutex_buffer);
+#if CONFIG_IDF_TARGET_LINUX
+    telemetry_file = fopen(TELEMETRY_LINUX_PATH, "wb");
+    if (telemetry_file == NULL) {
+        return ESP_FAIL;
+    }
+#else
+    uart_config_t uart_cfg = {
+        .baud_rate = TELEMETRY_BAUD_RATE,
+        .data_bits = UART_DATA_8_BITS,
+        .parity = UART_PARITY_DISABLE,
+        .stop_bits = UART_STOP_BITS_1,
+        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+        .source_clk = UART_SCLK_DEFAULT,
+    };
+    // El driver exige un buffer de recepción mayor que la FIFO aunque no se reciba nada
+    esp_err_t ret = uart_driver_install(TELEMETRY_UART, 256, TELEMETRY_TX_BUFFER, 0, NULL, 0);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ESP_ERROR_CHECK(uart_param_config(TELEMETRY_UART, &uart_cfg));
+    ESP_ERROR_CHECK(uart_set_pin(TELEMETRY_UART, TELEMETRY_TX_GPIO, TELEMETRY_RX_GPIO,
+                                 UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
+#endif
+    ESP_LOGI(TAG, "Binary telemetry at %d baud", TELEMETRY_BAUD_RATE);
+    return ESP_OK;
+}
+
+// Completa la cabecera y el CRC del registro, lo codifica y lo envía en una sola escritura
+static void telemetry_send(uint8_t *record, size_t payload_len) {
+    uint8_t frame[TELEMETRY_FRAME_MAX];
+    size_t len = 2 + payload_len;
+    xSemaphoreTake(telemetry_mutex, portMAX_DELAY);
+    record[1] = telemetry_counter++;
+    uint16_t crc = telemetry_crc16(record, len);
+    record[len++] = crc & 0xFF;
+    record[len++] = crc >> 8;
+
+    size_t frame_len = telemetry_cobs_encode(record, len, frame);
+#if CONFIG_IDF_TARGET_LINUX
+    if (telemetry_file != NULL) {
+        fwrite(frame, 1, frame_len, telemetry_file);
+        fflush(telemetry_file);
+    }
+#else
+    uart_write_bytes(TELEMETRY_UART, frame, frame_len);
+#endif
+    xSemaphoreGive(telemetry_mutex);
+}
+
+// Cabecera común de SAMPLE y DEVIATION; devuelve la posición de la siguiente carga
+static size_t telemetry_put_sample_header(uint8_t *record, telemetry_type_t type, const sensor_data_t *data) {
+    record[0] = type;
+    memcpy(&record[2], &data->timestamp_us, 4);
+    memcpy(&record[6], &data->seq, 2);
+    record[8] = data->flags;
+    return 9;
+}
+
+// Temperaturas de los canales de flags, en orden de canal
+static size_t telemetry_put_temperatures(uint8_t *record, size_t pos, const sensor_data_t *data) {
+    uint8_t mask = sensor_data_channels(data);
+    for (uint8_t c = 0; c < SENSOR_CHANNELS; c++) {
+        if (mask & (1u << c)) {
+            memcpy(&record[pos], &data->temperature[c], 2);
+            pos += 2;
+        }
+    }
+    return pos;
+}
+
+void telemetry_sample(const sensor_data_t *data) {
+    uint8_t record[TELEMETRY_RECORD_MAX];
+    size_t pos = telemetry_put_sample_header(record, TELEMETRY_SAMPLE, data);
+    pos = telemetry_put_temperatures(record, pos, data);
+    telemetry_send(record, pos - 2);
+}
+
+void telemetry_deviation(const sensor_data_t *data) {
+    uint8_t record[TELEMETRY_RECORD_MAX];
+    size_t pos = telemetry_put_sample_header(record, TELEMETRY_DEVIATION, data);
+    // Desviación en unidades de 1e-4, saturada (también si no es un número)
+    float deviation = sensor_data_deviation(data) * 10000.0f;
+    uint16_t dev = !(deviation < UINT16_MAX) ? UINT16_MAX : (uint16_t)(deviation + 0.5f);
+    memcpy(&record[pos], &dev, 2);
+    pos = telemetry_put_temperatures(record, pos + 2, data);
+    telemetry_send(record, pos - 2);
+}
+
+void telemetry_state(uint32_t timestamp_us, uint8_t from, uint8_t to) {
+    uint8_t record[2 + 6 + 2];
+    record[0] = TELEMETRY_STATE;
+    memcpy(&record[2], &timestamp_us, 4);
+    record[6] = from;
+    record[7] = to;
+    telemetry_send(record, 6);
+}
+
+void telemetry_stats(const telemetry_stats_t *stats) {
+    uint8_t record[TELEMETRY_RECORD_MAX];
+    record[0] = TELEMETRY_STATS;
+    memcpy(&record[2], stats, sizeof(telemetry_stats_t));
+    telemetry_send(record, sizeof(telemetry_stats_t));
+}
+
+#endif  // TELEMETRY_ENABLE
@@ -1,15 +1,119 @@
 #include "therm.h"
 
-#include <driver/gpio.h>
-#include <esp_adc/adc_oneshot.h>
+#include <esp_timer.h>
 #include <math.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "config.h"
 
+#if !CONFIG_IDF_TARGET_LINUX
+#include <driver/gpio.h>
+#include <esp_adc/adc_continuous.h>
+#include <esp_adc/adc_oneshot.h>
+#include <soc/soc_caps.h>
+
 // Manejador ADC estático compartido por todos los termistores
 static adc_oneshot_unit_handle_t shared_adc_hdlr = NULL;
 static bool adc_initialized = false;
 
+// Formato de las tramas DMA según la familia del SoC
+#if CONFIG_IDF_TARGET_ESP32 || CONFIG_IDF_TARGET_ESP32S2
+#define THERM_ADC_OUTPUT_TYPE ADC_DIGI_OUTPUT_FORMAT_TYPE1
+#define THERM_ADC_GET_CHANNEL(p) ((p)->type1.channel)
+#define THERM_ADC_GET_DATA(p) ((p)->type1.data)
+#else
+#define THERM_ADC_OUTPUT_TYPE ADC_DIGI_OUTPUT_FORMAT_TYPE2
+#define THERM_ADC_GET_CHANNEL(p) ((p)->type2.channel)
+#define THERM_ADC_GET_DATA(p) ((p)->type2.data)
+#endif
+
+// Estado del modo continuo (una única unidad ADC compartida)
+static adc_continuous_handle_t cont_hdlr = NULL;
+static uint8_t* cont_frame = NULL;                  // Trama DMA en curso
+static uint32_t cont_frame_bytes = 0;               // Tamaño de trama en bytes
+static int8_t cont_index[SOC_ADC_MAX_CHANNEL_NUM];  // Canal ADC -> índice de termistor
+static size_t cont_count = 0;                       // Número de termistores escaneados
+#endif
+
+// Tablas de conversión ya construidas, reutilizadas por termistores con los mismos parámetros
+#define THERM_LUT_SHIFT (12 - THERM_LUT_BITS)
+#define THERM_LUT_ENTRIES ((1 << THERM_LUT_BITS) + 1)
+#define THERM_LUT_MAX_TABLES 4
+
+#if THERM_LUT_ENABLE
+typedef struct {
+    float series_resistance;
+    float nominal_resistance;
+    float nominal_temperature;
+    float beta_coefficient;
+    float* lut;
+} therm_lut_cache_t;
+
+static therm_lut_cache_t lut_cache[THERM_LUT_MAX_TABLES];
+#endif
+
+#if THERM_LUT_ENABLE
+// Construye (o reutiliza) la tabla LSB -> °C evaluando la fórmula en cada punto
+static const float* _therm_build_lut(float series_resistance, float nominal_resistance,
+                                     float nominal_temperature, float beta_coefficient) {
+    therm_lut_cache_t* slot = NULL;
+    for (int i = 0; i < THERM_LUT_MAX_TABLES; i++) {
+        therm_lut_cache_t* c = &lut_cache[i];
+        if (c->lut == NULL) {
+            if (slot == NULL) slot = c;
+        } else if (c->series_resistance == series_resistance && c->nominal_resistance == nominal_resistance &&
+                   c->nominal_temperature == nominal_temperature && c->beta_coefficient == beta_coefficient) {
+            return c->lut;
+        }
+    }
+    if (slot == NULL) {
+        return NULL;
+    }
+
+    float* lut = malloc(THERM_LUT_ENTRIES * sizeof(float));
+    if (lut == NULL) {
+        return NULL;
+    }
+    for (uint32_t i = 0; i < THERM_LUT_ENTRIES; i++) {
+        uint32_t lsb = i << THERM_LUT_SHIFT;
+        if (lsb > 4095) lsb = 4095;
+        lut[i] = _therm_voltage_to_temperature(_therm_lsb_to_voltage(lsb), series_resistance, nominal_resistance,
+                                               nominal_temperature, beta_coefficient);
+    }
+
+    slot->series_resistance = series_resistance;
+    slot->nominal_resistance = nominal_resistance;
+    slot->nominal_temperature = nominal_temperature;
+    slot->beta_coefficient = beta_coefficient;
+    slot->lut = lut;
+    return lut;
+}
+#endif
+
+// Rellena los parámetros del termistor y le asigna su tabla de conversión
+esp_err_t _therm_configure(therm_t* thermistor, adc_channel_t channel, gpio_num_t power_gpio,
+                           float series_resistance, float nominal_resistance,
+                           float nominal_temperature, float beta_coefficient) {
+    thermistor->adc_hdlr = NULL;
+    thermistor->adc_channel = channel;
+    thermistor->power_gpio = power_gpio;
+    thermistor->settle_us = THERM_SETTLE_US;
+    thermistor->series_resistance = series_resistance;
+    thermistor->nominal_resistance = nominal_resistance;
+    thermistor->nominal_temperature = nominal_temperature;
+    thermistor->beta_coefficient = beta_coefficient;
+    thermistor->lut = NULL;
+#if THERM_LUT_ENABLE
+    thermistor->lut = _therm_build_lut(series_resistance, nominal_resistance, nominal_temperature, beta_coefficient);
+    if (thermistor->lut == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+#endif
+    return ESP_OK;
+}
+
+#if !CONFIG_IDF_TARGET_LINUX
 esp_err_t therm_init(therm_t* thermistor, adc_channel_t channel, gpio_num_t power_gpio,
                      float series_resistance, float nominal_resistance,
                      float nominal_temperature, float beta_coefficient) {
@@ -31,13 +135,12 @@ esp_err_t therm_init(therm_t* thermistor, adc_channel_t channel, gpio_num_t powe
     ESP_ERROR_CHECK(gpio_config(&io_conf));
 
     // Configura el termistor
+    esp_err_t ret = _therm_configure(thermistor, channel, power_gpio, series_resistance, nominal_resistance,
+                                     nominal_temperature, beta_coefficient);
+    if (ret != ESP_OK) {
+        return ret;
+    }
     thermistor->adc_hdlr = shared_adc_hdlr;
-    thermistor->adc_channel = channel;
-    thermistor->power_gpio = power_gpio;
-    thermistor->series_resistance = series_resistance;
-    thermistor->nominal_resistance = nominal_resistance;
-    thermistor->nominal_temperature = nominal_temperature;
-    thermistor->beta_coefficient = beta_coefficient;
 
     // Configura el canal ADC
     adc_oneshot_chan_cfg_t channel_cfg = {
@@ -48,12 +151,28 @@ esp_err_t therm_init(therm_t* thermistor, adc_channel_t channel, gpio_num_t powe
 
     return ESP_OK;
 }
+#endif
 
 // Lee la temperatura del termistor
 float therm_read_temperature(therm_t thermistor) {
-    uint16_t lsb = therm_read_lsb(thermistor);
+    return therm_lsb_to_temperature(thermistor, therm_read_lsb(thermistor));
+}
+
+// Convierte una lectura LSB en temperatura con los parámetros del termistor
+float therm_lsb_to_temperature(therm_t thermistor, uint16_t lsb) {
+#if THERM_LUT_ENABLE
+#if THERM_LUT_BITS == 12
+    return thermistor.lut[lsb & 0x0FFF];
+#else
+    // Interpolación lineal entre las dos entradas que rodean al código ADC
+    const float* p = &thermistor.lut[(lsb & 0x0FFF) >> THERM_LUT_SHIFT];
+    float frac = (lsb & ((1 << THERM_LUT_SHIFT) - 1)) * (1.0f / (1 << THERM_LUT_SHIFT));
+    return p[0] + (p[1] - p[0]) * frac;
+#endif
+#else
     float voltage = _therm_lsb_to_voltage(lsb);
     return _therm_voltage_to_temperature(voltage, thermistor.series_resistance, thermistor.nominal_resistance, thermistor.nominal_temperature, thermistor.beta_coefficient);
+#endif
 }
 
 // Lee el voltaje del termistor
@@ -62,6 +181,7 @@ float therm_read_voltage(therm_t thermistor) {
     return _therm_lsb_to_voltage(lsb);
 }
 
+#if !CONFIG_IDF_TARGET_LINUX
 // Lee el valor LSB del termistor
 uint16_t therm_read_lsb(therm_t thermistor) {
     int raw_value = 0;
@@ -71,13 +191,137 @@ uint16_t therm_read_lsb(therm_t thermistor) {
 
 void therm_power_on(therm_t thermistor) {
     gpio_set_level(thermistor.power_gpio, 1);
-    vTaskDelay(pdMS_TO_TICKS(10));  // Permite tiempo de estabilización
+    vTaskDelay(pdMS_TO_TICKS((thermistor.settle_us + 999) / 1000));  // Permite tiempo de estabilización
+}
+
+int64_t therm_power_on_async(therm_t thermistor) {
+    gpio_set_level(thermistor.power_gpio, 1);
+    return esp_timer_get_time() + thermistor.settle_us;
 }
 
 void therm_power_off(therm_t thermistor) {
     gpio_set_level(thermistor.power_gpio, 0);
 }
 
+// Arranca la adquisición continua de todos los termistores
+esp_err_t therm_continuous_start(const therm_t* thermistors, size_t count, uint32_t sample_freq_hz, uint32_t frame_conversions) {
+    if (cont_hdlr != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (count == 0 || count > SOC_ADC_PATT_LEN_MAX || frame_conversions < count) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // El modo continuo y el oneshot no pueden compartir la unidad ADC
+    if (adc_initialized) {
+        ESP_ERROR_CHECK(adc_oneshot_del_unit(shared_adc_hdlr));
+        shared_adc_hdlr = NULL;
+        adc_initialized = false;
+    }
+
+    cont_frame_bytes = frame_conversions * SOC_ADC_DIGI_DATA_BYTES_PER_CONV;
+    cont_frame = malloc(cont_frame_bytes);
+    if (cont_frame == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Pool del driver: varias tramas para absorber la latencia de la tarea lectora
+    adc_continuous_handle_cfg_t handle_cfg = {
+        .max_store_buf_size = cont_frame_bytes * 4,
+        .conv_frame_size = cont_frame_bytes,
+    };
+    esp_err_t ret = adc_continuous_new_handle(&handle_cfg, &cont_hdlr);
+    if (ret != ESP_OK) {
+        free(cont_frame);
+        cont_frame = NULL;
+        return ret;
+    }
+
+    // Patrón de escaneo: un canal por termistor
+    adc_digi_pattern_config_t pattern[SOC_ADC_PATT_LEN_MAX] = {0};
+    memset(cont_index, -1, sizeof(cont_index));
+    for (size_t i = 0; i < count; i++) {
+        pattern[i].atten = ADC_ATTEN_DB_12;
+        pattern[i].channel = thermistors[i].adc_channel;
+        pattern[i].unit = THERMISTOR_ADC_UNIT;
+        pattern[i].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+        cont_index[thermistors[i].adc_channel] = i;
+    }
+    cont_count = count;
+
+    adc_continuous_config_t dig_cfg = {
+        .pattern_num = count,
+        .adc_pattern = pattern,
+        .sample_freq_hz = sample_freq_hz,
+        .conv_mode = ADC_CONV_SINGLE_UNIT_1,
+        .format = THERM_ADC_OUTPUT_TYPE,
+    };
+    ESP_ERROR_CHECK(adc_continuous_config(cont_hdlr, &dig_cfg));
+    ESP_ERROR_CHECK(adc_continuous_start(cont_hdlr));
+
+    return ESP_OK;
+}
+
+// Lee una trama completa y la reduce a la media LSB de cada termistor
+esp_err_t therm_continuous_read(uint16_t* lsb, size_t count, uint32_t timeout_ms) {
+    uint32_t sum[SOC_ADC_PATT_LEN_MAX] = {0};
+    uint32_t n[SOC_ADC_PATT_LEN_MAX] = {0};
+    uint32_t ret_num = 0;
+
+    if (cont_hdlr == NULL || count > cont_count) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t ret = adc_continuous_read(cont_hdlr, cont_frame, cont_frame_bytes, &ret_num, timeout_ms);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    // Demultiplexa la trama por canal
+    for (uint32_t i = 0; i < ret_num; i += SOC_ADC_DIGI_RESULT_BYTES) {
+        adc_digi_output_data_t* p = (adc_digi_output_data_t*)&cont_frame[i];
+        uint32_t channel = THERM_ADC_GET_CHANNEL(p);
+        if (channel < SOC_ADC_MAX_CHANNEL_NUM && cont_index[channel] >= 0) {
+            sum[cont_index[channel]] += THERM_ADC_GET_DATA(p);
+            n[cont_index[channel]]++;
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (n[i] == 0) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        lsb[i] = (sum[i] + n[i] / 2) / n[i];
+    }
+
+    return ESP_OK;
+}
+
+// Vacía el pool de tramas pendientes
+void therm_continuous_flush(void) {
+    uint32_t ret_num = 0;
+    if (cont_hdlr == NULL) {
+        return;
+    }
+    while (adc_continuous_read(cont_hdlr, cont_frame, cont_frame_bytes, &ret_num, 0) == ESP_OK) {
+    }
+}
+
+// Detiene la adquisición continua y libera el driver
+esp_err_t therm_continuous_stop(void) {
+    if (cont_hdlr == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    ESP_ERROR_CHECK(adc_continuous_stop(cont_hdlr));
+    ESP_ERROR_CHECK(adc_continuous_deinit(cont_hdlr));
+    cont_hdlr = NULL;
+    free(cont_frame);
+    cont_frame = NULL;
+    cont_count = 0;
+    return ESP_OK;
+}
+#endif
+
 // Convierte el voltaje a temperatura en grados Celsius
 float _therm_voltage_to_temperature(float voltage, float series_resistance, float nominal_resistance, float nominal_temperature, float beta_coefficient) {
     float r_ntc = series_resistance * (3.3 - voltage) / voltage;
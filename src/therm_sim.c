@@ -0,0 +1,264 @@
+// therm_sim.c
+
+#include "therm.h"
+
+#if CONFIG_IDF_TARGET_LINUX
+
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <math.h>
+#include <stdbool.h>
+
+#include "config.h"
+#include "therm_sim.h"
+
+// Canales simulados (ADC_CHANNEL_0 .. ADC_CHANNEL_9)
+#define THERM_SIM_MAX_CHANNELS 10
+
+typedef struct {
+    bool initialized;            // therm_init() ya ha registrado el canal
+    bool curve_set;              // Curva fijada con therm_sim_set_curve()
+    bool powered;
+    int64_t settled_us;          // Instante en que la lectura pasa a ser válida
+    therm_t therm;               // Parámetros del divisor, para pasar de °C a LSB
+    therm_sim_curve_t curve;
+    therm_sim_fault_t fault;
+    float fault_value;
+    uint32_t fault_at_ms;
+    uint16_t last_lsb;           // Última lectura (para THERM_SIM_FAULT_STUCK)
+} therm_sim_channel_t;
+
+static therm_sim_channel_t sim_channels[THERM_SIM_MAX_CHANNELS];
+static int64_t sim_t0_us = -1;      // Instante del primer therm_init()
+static uint32_t sim_rand = 0x2545F491;
+
+// Estado del modo continuo: una trama por periodo, marcada por el tick de FreeRTOS
+static bool cont_running = false;
+static adc_channel_t cont_channels[THERM_SIM_MAX_CHANNELS];
+static size_t cont_count = 0;
+static TickType_t cont_period_ticks = 0;
+static TickType_t cont_last_frame = 0;
+
+static therm_sim_channel_t* _therm_sim_channel(adc_channel_t channel) {
+    return ((unsigned)channel < THERM_SIM_MAX_CHANNELS) ? &sim_channels[channel] : NULL;
+}
+
+// Segundos transcurridos desde el arranque de la simulación
+static float _therm_sim_elapsed_s(void) {
+    return sim_t0_us < 0 ? 0.0f : (esp_timer_get_time() - sim_t0_us) * 1e-6f;
+}
+
+// Ruido uniforme en [-amplitude, amplitude] (xorshift32)
+static int32_t _therm_sim_noise(uint16_t amplitude) {
+    if (amplitude == 0) {
+        return 0;
+    }
+    sim_rand ^= sim_rand << 13;
+    sim_rand ^= sim_rand >> 17;
+    sim_rand ^= sim_rand << 5;
+    return (int32_t)(sim_rand % (2u * amplitude + 1)) - amplitude;
+}
+
+static float _therm_sim_curve(const therm_sim_curve_t* c, float t) {
+    float temperature = c->base_c + c->ramp_c_per_s * t;
+    if (c->period_s > 0.0f) {
+        temperature += c->amplitude_c * sinf(2.0f * (float)M_PI * t / c->period_s);
+    }
+    return temperature;
+}
+
+// Código ADC del divisor (serie a 3.3 V, NTC a masa) para una temperatura
+static uint16_t _therm_sim_temperature_to_lsb(const therm_t* therm, float temperature) {
+    float t_kelvin = temperature + 273.15f;
+    float r_ntc = therm->nominal_resistance *
+                  expf(therm->beta_coefficient * (1.0f / t_kelvin - 1.0f / therm->nominal_temperature));
+    float lsb = 4095.0f * therm->series_resistance / (therm->series_resistance + r_ntc);
+    return (uint16_t)lroundf(lsb);
+}
+
+// Lectura del canal en este instante, con el fallo y el ruido aplicados
+static uint16_t _therm_sim_read(therm_sim_channel_t* ch) {
+    // Sin alimentación, o aún estabilizándose, el divisor no da una lectura útil
+    if (!ch->powered || esp_timer_get_time() < ch->settled_us) {
+        return 0;
+    }
+
+    float t = _therm_sim_elapsed_s();
+    float fault_t = t - ch->fault_at_ms * 1e-3f;
+    float temperature = _therm_sim_curve(&ch->curve, t);
+    if (fault_t >= 0.0f) {
+        switch (ch->fault) {
+            case THERM_SIM_FAULT_OFFSET:
+                temperature += ch->fault_value;
+                break;
+            case THERM_SIM_FAULT_DRIFT:
+                temperature += ch->fault_value * fault_t;
+                break;
+            case THERM_SIM_FAULT_STUCK:
+                return ch->last_lsb;
+            case THERM_SIM_FAULT_OPEN:
+                return 0;
+            case THERM_SIM_FAULT_SHORT:
+                return 4095;
+            default:
+                break;
+        }
+    }
+
+    int32_t lsb = _therm_sim_temperature_to_lsb(&ch->therm, temperature) + _therm_sim_noise(ch->curve.noise_lsb);
+    if (lsb < 0) lsb = 0;
+    if (lsb > 4095) lsb = 4095;
+    ch->last_lsb = lsb;
+    return lsb;
+}
+
+// Registra el termistor en el modelo; el primero arranca el reloj de la simulación
+esp_err_t therm_init(therm_t* thermistor, adc_channel_t channel, gpio_num_t power_gpio,
+                     float series_resistance, float nominal_resistance,
+                     float nominal_temperature, float beta_coefficient) {
+    therm_sim_channel_t* ch = _therm_sim_channel(channel);
+    if (ch == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t ret = _therm_configure(thermistor, channel, power_gpio, series_resistance, nominal_resistance,
+                                     nominal_temperature, beta_coefficient);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    if (sim_t0_us < 0) {
+        sim_t0_us = esp_timer_get_time();
+        therm_sim_channel_t* faulty = _therm_sim_channel(THERM_SIM_FAULT_CHANNEL);
+        if (faulty != NULL && faulty->fault == THERM_SIM_FAULT_NONE) {
+            therm_sim_inject_fault(THERM_SIM_FAULT_CHANNEL, THERM_SIM_FAULT, THERM_SIM_FAULT_VALUE, THERM_SIM_FAULT_AT_MS);
+        }
+    }
+
+    if (!ch->curve_set) {
+        therm_sim_curve_t curve = {
+            .base_c = THERM_SIM_BASE_C,
+            .amplitude_c = THERM_SIM_AMPLITUDE_C,
+            .period_s = THERM_SIM_PERIOD_S,
+            .ramp_c_per_s = THERM_SIM_RAMP_C_PER_S,
+            .noise_lsb = THERM_SIM_NOISE_LSB,
+        };
+        ch->curve = curve;
+    }
+    ch->therm = *thermistor;
+    ch->initialized = true;
+    return ESP_OK;
+}
+
+uint16_t therm_read_lsb(therm_t thermistor) {
+    therm_sim_channel_t* ch = _therm_sim_channel(thermistor.adc_channel);
+    return (ch != NULL && ch->initialized) ? _therm_sim_read(ch) : 0;
+}
+
+void therm_power_on(therm_t thermistor) {
+    therm_power_on_async(thermistor);
+    vTaskDelay(pdMS_TO_TICKS((thermistor.settle_us + 999) / 1000));  // Mismo tiempo de estabilización que el hardware
+}
+
+int64_t therm_power_on_async(therm_t thermistor) {
+    therm_sim_channel_t* ch = _therm_sim_channel(thermistor.adc_channel);
+    if (ch == NULL) {
+        return esp_timer_get_time() + thermistor.settle_us;
+    }
+    if (!ch->powered) {
+        ch->powered = true;
+        ch->settled_us = esp_timer_get_time() + thermistor.settle_us;
+    }
+    return ch->settled_us;
+}
+
+void therm_power_off(therm_t thermistor) {
+    therm_sim_channel_t* ch = _therm_sim_channel(thermistor.adc_channel);
+    if (ch != NULL) {
+        ch->powered = false;
+    }
+}
+
+// Simula el escaneo continuo: una trama cada frame_conversions / sample_freq_hz
+esp_err_t therm_continuous_start(const therm_t* thermistors, size_t count, uint32_t sample_freq_hz, uint32_t frame_conversions) {
+    if (cont_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (count == 0 || count > THERM_SIM_MAX_CHANNELS || frame_conversions < count || sample_freq_hz == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (_therm_sim_channel(thermistors[i].adc_channel) == NULL) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        cont_channels[i] = thermistors[i].adc_channel;
+    }
+    cont_count = count;
+    cont_period_ticks = pdMS_TO_TICKS(((uint64_t)frame_conversions * 1000) / sample_freq_hz);
+    if (cont_period_ticks == 0) {
+        cont_period_ticks = 1;
+    }
+    cont_last_frame = xTaskGetTickCount();
+    cont_running = true;
+    return ESP_OK;
+}
+
+// Espera al final de la siguiente trama y devuelve una lectura por termistor
+esp_err_t therm_continuous_read(uint16_t* lsb, size_t count, uint32_t timeout_ms) {
+    if (!cont_running || count > cont_count) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Ticks hasta el final de la trama (negativo si ya ha terminado y está pendiente)
+    int32_t wait = (int32_t)(cont_last_frame + cont_period_ticks - xTaskGetTickCount());
+    if (wait > (int32_t)pdMS_TO_TICKS(timeout_ms)) {
+        vTaskDelay(pdMS_TO_TICKS(timeout_ms));
+        return ESP_ERR_TIMEOUT;
+    }
+    xTaskDelayUntil(&cont_last_frame, cont_period_ticks);
+
+    for (size_t i = 0; i < count; i++) {
+        lsb[i] = _therm_sim_read(&sim_channels[cont_channels[i]]);
+    }
+    return ESP_OK;
+}
+
+// Descarta las tramas pendientes: la siguiente termina un periodo después de ahora
+void therm_continuous_flush(void) {
+    cont_last_frame = xTaskGetTickCount();
+}
+
+esp_err_t therm_continuous_stop(void) {
+    if (!cont_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    cont_running = false;
+    cont_count = 0;
+    return ESP_OK;
+}
+
+void therm_sim_set_curve(adc_channel_t channel, const therm_sim_curve_t* curve) {
+    therm_sim_channel_t* ch = _therm_sim_channel(channel);
+    if (ch != NULL) {
+        ch->curve = *curve;
+        ch->curve_set = true;
+    }
+}
+
+void therm_sim_inject_fault(adc_channel_t channel, therm_sim_fault_t fault, float value, uint32_t at_ms) {
+    therm_sim_channel_t* ch = _therm_sim_channel(channel);
+    if (ch != NULL) {
+        ch->fault = fault;
+        ch->fault_value = value;
+        ch->fault_at_ms = at_ms;
+    }
+}
+
+float therm_sim_temperature(adc_channel_t channel) {
+    therm_sim_channel_t* ch = _therm_sim_channel(channel);
+    return ch != NULL ? _therm_sim_curve(&ch->curve, _therm_sim_elapsed_s()) : NAN;
+}
+
+#endif  // CONFIG_IDF_TARGET_LINUX
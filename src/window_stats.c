@@ -0,0 +1,74 @@
+// window_stats.c
+
+#include "window_stats.h"
+
+#include <string.h>
+
+_Static_assert(WINDOW_STATS_SIZE >= 2 && (WINDOW_STATS_SIZE & (WINDOW_STATS_SIZE - 1)) == 0,
+               "WINDOW_STATS_SIZE debe ser potencia de 2");
+
+#define WINDOW_STATS_MASK (WINDOW_STATS_SIZE - 1)
+
+void window_stats_reset(window_stats_t* stats) {
+    memset(stats, 0, sizeof(*stats));
+}
+
+// Cola monótona: descarta del principio la posición que sale de la ventana, quita del
+// final las que la nueva muestra domina (nunca volverán a ser el extremo) y añade la
+// nueva. El extremo queda en la cabeza
+static void window_stats_push(const window_stats_t* stats, uint32_t* q, uint32_t* head, uint32_t* tail,
+                              float x, int sign) {
+    if (*tail != *head && stats->pos - q[*head & WINDOW_STATS_MASK] >= WINDOW_STATS_SIZE) {
+        (*head)++;
+    }
+    while (*tail != *head && sign * (stats->values[q[(*tail - 1) & WINDOW_STATS_MASK] & WINDOW_STATS_MASK] - x) >= 0) {
+        (*tail)--;
+    }
+    q[(*tail)++ & WINDOW_STATS_MASK] = stats->pos;
+}
+
+void window_stats_add(window_stats_t* stats, float x) {
+    if (stats->count == 0) {
+        stats->ewma = x;
+    } else {
+        stats->ewma += WINDOW_STATS_EWMA_ALPHA * (x - stats->ewma);
+    }
+
+    // Welford: con la ventana llena la muestra nueva sustituye a la más antigua
+    float* slot = &stats->values[stats->pos & WINDOW_STATS_MASK];
+    if (stats->count < WINDOW_STATS_SIZE) {
+        stats->count++;
+        float delta = x - stats->mean;
+        stats->mean += delta / stats->count;
+        stats->m2 += delta * (x - stats->mean);
+    } else {
+        float old = *slot;
+        float mean = stats->mean + (x - old) / WINDOW_STATS_SIZE;
+        stats->m2 += (x - old) * (x - mean + old - stats->mean);
+        stats->mean = mean;
+        // El redondeo acumulado puede dejarla ligeramente negativa
+        if (stats->m2 < 0.0f) {
+            stats->m2 = 0.0f;
+        }
+    }
+    *slot = x;
+
+    // La muestra que sale (pos - SIZE) ocupaba este mismo hueco: las colas la descartan
+    // antes de comparar
+    window_stats_push(stats, stats->min_q, &stats->min_head, &stats->min_tail, x, 1);
+    window_stats_push(stats, stats->max_q, &stats->max_head, &stats->max_tail, x, -1);
+    stats->pos++;
+}
+
+void window_stats_get(const window_stats_t* stats, window_summary_t* summary) {
+    memset(summary, 0, sizeof(*summary));
+    if (stats->count == 0) {
+        return;
+    }
+    summary->count = stats->count;
+    summary->mean = stats->mean;
+    summary->variance = stats->count > 1 ? stats->m2 / (stats->count - 1) : 0.0f;
+    summary->min = stats->values[stats->min_q[stats->min_head & WINDOW_STATS_MASK] & WINDOW_STATS_MASK];
+    summary->max = stats->values[stats->max_q[stats->max_head & WINDOW_STATS_MASK] & WINDOW_STATS_MASK];
+    summary->ewma = stats->ewma;
+}
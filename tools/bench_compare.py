@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+"""Compare two benchmark runs (see include/bench.h) and report regressions.
+
+Reads the console output of a run with BENCH_ENABLE, keeps the JSON result
+lines and ignores the rest of the log. Each result is identified by target,
+bench, case and metric; when a key appears several times (the soak reports
+every BENCH_SOAK_REPORT_S) the last value is used. The change column is how
+much worse (+) or better (-) the current run is, in %. Exits with 1 if any
+result is worse than the baseline by more than the threshold.
+
+    tools/bench_compare.py baseline.log current.log
+    tools/bench_compare.py baseline.log current.log --threshold 5 --csv diff.csv
+"""
+
+import argparse
+import csv
+import json
+import sys
+
+FORMAT_VERSION = 1
+
+# Units where a larger value is better; for the rest (time, cycles, losses, RAM used) smaller is better
+HIGHER_IS_BETTER = {"items/s", "samples/s", "bool"}
+# Results that describe the run rather than its performance
+INFORMATIVE = {("soak", "pipeline", "elapsed"), ("soak", "pipeline", "produced"), ("soak", "pipeline", "consumed")}
+
+
+def load(path):
+    """Results of a run: {(target, bench, case, metric): (value, unit)}."""
+    results = {}
+    with open(path, errors="replace") as f:
+        for line in f:
+            line = line.strip()
+            if not line.startswith("{"):
+                continue
+            try:
+                r = json.loads(line)
+            except ValueError:
+                continue
+            if r.get("v") != FORMAT_VERSION:
+                continue
+            results[(r["target"], r["bench"], r["case"], r["metric"])] = (r["value"], r["unit"])
+    return results
+
+
+def higher_is_better(metric, unit):
+    # Free stack and heap are margins
+    return unit in HIGHER_IS_BETTER or metric.endswith("_free")
+
+
+def change(base, value, metric, unit):
+    """Relative change in %, positive when the result got worse."""
+    delta = value - base
+    if higher_is_better(metric, unit):
+        delta = -delta
+    if delta == 0:
+        return 0.0
+    if base == 0:
+        return float("inf") if delta > 0 else float("-inf")
+    return delta / abs(base) * 100.0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("baseline", help="log of the reference run")
+    parser.add_argument("current", help="log of the run to check")
+    parser.add_argument("--threshold", type=float, default=10.0, help="worse by more than this %% is a regression")
+    parser.add_argument("--csv", help="also write the comparison to this CSV file")
+    args = parser.parse_args()
+
+    baseline = load(args.baseline)
+    current = load(args.current)
+    if not baseline or not current:
+        print("no benchmark results in %s" % (args.baseline if not baseline else args.current), file=sys.stderr)
+        return 2
+
+    rows = []
+    regressions = 0
+    for key in sorted(set(baseline) | set(current)):
+        target, bench, case, metric = key
+        base, unit = baseline.get(key, (None, None))
+        value, unit = current.get(key, (None, unit))
+        if key not in baseline or key not in current:
+            status = "only in " + ("current" if key not in baseline else "baseline")
+            worse = None
+        elif base is None or value is None:
+            # null: the run could not compute the value (nan or inf on the target)
+            status = "no value"
+            worse = None
+        else:
+            worse = change(base, value, metric, unit)
+            if (bench, case, metric) in INFORMATIVE:
+                status = ""
+            elif worse > args.threshold:
+                status = "REGRESSION"
+                regressions += 1
+            elif worse < -args.threshold:
+                status = "improved"
+            else:
+                status = ""
+        rows.append([target, bench, case, metric, unit, base, value, worse, status])
+
+    fmt = lambda v: "-" if v is None else "%.3f" % v
+    for target, bench, case, metric, unit, base, value, worse, status in rows:
+        name = "%s/%s/%s/%s" % (target, bench, case, metric)
+        pct = "" if worse is None else "%+.1f%%" % worse
+        print("%-60s %14s %14s %-11s %9s %s" % (name, fmt(base), fmt(value), unit, pct, status))
+
+    if args.csv:
+        with open(args.csv, "w", newline="") as f:
+            writer = csv.writer(f)
+            writer.writerow(["target", "bench", "case", "metric", "unit", "baseline", "current", "worse_pct", "status"])
+            writer.writerows(rows)
+
+    print("%d results, %d regressions over %.1f%%" % (len(rows), regressions, args.threshold), file=sys.stderr)
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
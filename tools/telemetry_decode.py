@@ -0,0 +1,184 @@
+#!/usr/bin/env python3
+"""Decode the binary telemetry stream (see include/telemetry.h) into CSV files.
+
+Reads a capture file, stdin ("-") or a serial port (--port, needs pyserial) and
+writes one CSV per record type: <prefix>_samples.csv, <prefix>_deviation.csv,
+<prefix>_state.csv and <prefix>_stats.csv. Frames with a bad CRC are skipped and
+the gaps in the record counter are reported as lost records.
+
+    tools/telemetry_decode.py telemetry.bin -o run1
+    tools/telemetry_decode.py --port /dev/ttyUSB0 --baud 921600 -o run1
+"""
+
+import argparse
+import csv
+import struct
+import sys
+
+TELEMETRY_SAMPLE = 1
+TELEMETRY_DEVIATION = 2
+TELEMETRY_STATE = 3
+TELEMETRY_STATS = 4
+
+# Order of the state enum in config.h
+STATES = ["INIT", "SENSOR_LOOP", "NORMAL_MODE", "DEGRADED_MODE", "ERROR"]
+SOURCES = ["sensor", "checker"]
+
+STATS_FORMAT = "<7IB"
+STATS_FIELDS = ["uptime_ms", "produced", "consumed", "queue_drops", "posted", "suppressed", "dropped", "active"]
+
+
+def crc16(data):
+    """CRC-16/CCITT-FALSE, same as telemetry_crc16()."""
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def cobs_decode(frame):
+    """Decode one COBS frame (without the 0x00 delimiter); None if it is malformed."""
+    out = bytearray()
+    i = 0
+    while i < len(frame):
+        code = frame[i]
+        if code == 0 or i + code > len(frame):
+            return None
+        out += frame[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(frame):
+            out.append(0)
+    return bytes(out)
+
+
+def channels(mask, nchannels):
+    return [c for c in range(nchannels) if mask & (1 << c)]
+
+
+def temperatures(data, mask, nchannels):
+    """Temperatures in degC of the channels in mask, None for the others."""
+    present = channels(mask, nchannels)
+    values = struct.unpack_from("<%dh" % len(present), data)
+    row = [None] * nchannels
+    for c, value in zip(present, values):
+        row[c] = "%.2f" % (value / 100.0)
+    return row
+
+
+class Decoder:
+    def __init__(self, prefix, nchannels):
+        self.nchannels = nchannels
+        self.files = []
+        temp_cols = ["t%d" % (c + 1) for c in range(nchannels)]
+        self.samples = self._open(prefix + "_samples.csv", ["record", "timestamp_us", "seq", "source", "channels"] + temp_cols)
+        self.deviation = self._open(prefix + "_deviation.csv",
+                                    ["record", "timestamp_us", "seq", "channels", "deviation"] + temp_cols)
+        self.state = self._open(prefix + "_state.csv", ["record", "timestamp_us", "from", "to"])
+        self.stats = self._open(prefix + "_stats.csv", ["record"] + STATS_FIELDS)
+        self.frames = 0
+        self.bad = 0
+        self.lost = 0
+        self.last_counter = None
+
+    def _open(self, path, header):
+        f = open(path, "w", newline="")
+        self.files.append(f)
+        writer = csv.writer(f)
+        writer.writerow(header)
+        return writer
+
+    def close(self):
+        for f in self.files:
+            f.close()
+
+    def frame(self, frame):
+        if not frame:
+            return
+        self.frames += 1
+        record = cobs_decode(frame)
+        if record is None or len(record) < 4 or crc16(record[:-2]) != struct.unpack_from("<H", record, len(record) - 2)[0]:
+            self.bad += 1
+            return
+
+        rtype, counter = record[0], record[1]
+        payload = record[2:-2]
+        if self.last_counter is not None:
+            self.lost += (counter - self.last_counter - 1) & 0xFF
+        self.last_counter = counter
+
+        try:
+            if rtype == TELEMETRY_SAMPLE:
+                ts, seq, flags = struct.unpack_from("<IHB", payload)
+                mask = flags >> 2
+                self.samples.writerow([counter, ts, seq, SOURCES[flags & 0x03], "0x%02x" % mask] +
+                                      temperatures(payload[7:], mask, self.nchannels))
+            elif rtype == TELEMETRY_DEVIATION:
+                ts, seq, flags, dev = struct.unpack_from("<IHBH", payload)
+                mask = flags >> 2
+                self.deviation.writerow([counter, ts, seq, "0x%02x" % mask, "%.4f" % (dev / 10000.0)] +
+                                        temperatures(payload[9:], mask, self.nchannels))
+            elif rtype == TELEMETRY_STATE:
+                ts, old, new = struct.unpack_from("<IBB", payload)
+                name = lambda st: STATES[st] if st < len(STATES) else str(st)
+                self.state.writerow([counter, ts, name(old), name(new)])
+            elif rtype == TELEMETRY_STATS:
+                values = list(struct.unpack_from(STATS_FORMAT, payload))
+                values[-1] = "0x%02x" % values[-1]
+                self.stats.writerow([counter] + values)
+            else:
+                self.bad += 1
+        except (struct.error, IndexError):
+            self.bad += 1
+
+
+def chunks(args):
+    if args.port:
+        import serial  # pyserial
+
+        with serial.Serial(args.port, args.baud, timeout=1) as port:
+            while True:
+                data = port.read(4096)
+                if data:
+                    yield data
+    else:
+        src = sys.stdin.buffer if args.input == "-" else open(args.input, "rb")
+        with src:
+            while True:
+                data = src.read(65536)
+                if not data:
+                    return
+                yield data
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("input", nargs="?", default="-", help="capture file, '-' for stdin (default)")
+    parser.add_argument("--port", help="serial port to read instead of a file")
+    parser.add_argument("--baud", type=int, default=921600, help="serial baud rate (TELEMETRY_BAUD_RATE)")
+    parser.add_argument("-o", "--prefix", default="telemetry", help="prefix of the CSV files")
+    parser.add_argument("--channels", type=int, default=3, help="channels in the group (SENSOR_CHANNELS)")
+    args = parser.parse_args()
+
+    decoder = Decoder(args.prefix, args.channels)
+    pending = bytearray()
+    # The first frame may start mid-record: it is dropped by its CRC
+    try:
+        for data in chunks(args):
+            pending += data
+            *frames, rest = pending.split(b"\x00")
+            for frame in frames:
+                decoder.frame(bytes(frame))
+            pending = bytearray(rest)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        decoder.close()
+
+    print("%d frames, %d bad, %d records lost" % (decoder.frames, decoder.bad, decoder.lost), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()